@@ -3,8 +3,12 @@
 
 #include "util.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
 
 int main() {
     Timer timer;
@@ -32,6 +36,12 @@ int main() {
     }
     printf("}\n");
 
+    options.dedupTiles = true;
+    mapbox::geojsonvt::GeoJSONVT dedup{ features, options };
+    timer("generate tile index with deduplication");
+    printf("tile memory: %.1f KB, %.1f KB after deduplication\n", dedup.tileBytes / 1024.0,
+           dedup.uniqueTileBytes / 1024.0);
+
     const unsigned max_z = 11;
     std::size_t count = 0;
     for (unsigned z = 0; z < max_z; ++z) {
@@ -44,4 +54,163 @@ int main() {
         }
     }
     timer("getTile, found " + std::to_string(count) + " features");
+
+    // simplification algorithms: index generation time, and points in the z0-z5 tiles
+    for (const auto simplification : { mapbox::geojsonvt::Simplification::DouglasPeucker,
+                                       mapbox::geojsonvt::Simplification::VisvalingamWhyatt }) {
+        const bool dp = simplification == mapbox::geojsonvt::Simplification::DouglasPeucker;
+        mapbox::geojsonvt::Options simplified;
+        simplified.indexMaxZoom = 7;
+        simplified.indexMaxPoints = 200;
+        simplified.simplification = simplification;
+        for (uint32_t i = 0; i < 20; i++) {
+            mapbox::geojsonvt::GeoJSONVT index{ features, simplified };
+        }
+        timer(std::string(dp ? "Douglas-Peucker" : "Visvalingam-Whyatt") +
+              ": generate tile index 20 times");
+
+        mapbox::geojsonvt::GeoJSONVT index{ features, simplified };
+        uint64_t points = 0;
+        for (uint8_t z = 0; z <= 5; ++z) {
+            for (uint32_t x = 0; x < (1u << z); ++x) {
+                for (uint32_t y = 0; y < (1u << z); ++y) {
+                    points += index.getTile(z, x, y).num_simplified;
+                }
+            }
+        }
+        timer(std::string(dp ? "Douglas-Peucker" : "Visvalingam-Whyatt") + ": " +
+              std::to_string(points) + " points in z0-z5 tiles");
+    }
+
+    // Hilbert ordering on 100k small squares in random order, like parcels from a database
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> lon(-10, 20);
+    std::uniform_real_distribution<double> lat(35, 60);
+    mapbox::geojsonvt::feature_collection parcels;
+    for (uint32_t i = 0; i < 100000; ++i) {
+        const double x = lon(rng);
+        const double y = lat(rng);
+        mapbox::geometry::linear_ring<double> ring = {
+            { x, y }, { x + 0.01, y }, { x + 0.01, y + 0.01 }, { x, y + 0.01 }, { x, y }
+        };
+        parcels.push_back({ mapbox::geometry::polygon<double>{ ring }, {} });
+    }
+    timer("prepare 100k parcels");
+
+    for (const bool hilbert : { false, true }) {
+        const std::string name = hilbert ? "Hilbert order" : "input order";
+        mapbox::geojsonvt::Options ordered;
+        ordered.hilbertOrder = hilbert;
+        mapbox::geojsonvt::GeoJSONVT index{ parcels, ordered };
+        timer(name + ": generate tile index");
+
+        std::size_t found = 0;
+        for (uint32_t x = 124; x < 136; ++x) {
+            for (uint32_t y = 84; y < 96; ++y) {
+                found += index.getTile(8, x, y).features.size();
+            }
+        }
+        timer(name + ": drill down to 144 z8 tiles, found " + std::to_string(found) +
+              " features");
+    }
+
+    // latency of single cold requests that clip all 100k parcels at z0, each on a fresh index
+    for (const uint16_t chunkThreads : { 1, 0 }) {
+        const std::string name = chunkThreads == 1 ? "serial clip" : "chunked clip";
+        mapbox::geojsonvt::Options cold;
+        cold.indexMaxZoom = 0;
+        cold.chunkThreads = chunkThreads;
+
+        std::vector<double> latencies;
+        for (uint32_t i = 0; i < 20; ++i) {
+            mapbox::geojsonvt::GeoJSONVT index{ parcels, cold };
+            const auto started = std::chrono::high_resolution_clock::now();
+            index.getTile(8, 124 + i % 12, 84 + i * 5 % 12);
+            const auto elapsed = std::chrono::high_resolution_clock::now() - started;
+            latencies.push_back(
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000.0);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        // nearest rank, so p99 of 20 samples is the slowest one
+        const auto percentile = [&](const double p) {
+            return latencies[std::size_t(std::ceil(p * latencies.size())) - 1];
+        };
+        timer(name + ": 20 cold z8 requests, p50 " + std::to_string(percentile(0.5)) +
+              "ms, p99 " + std::to_string(percentile(0.99)) + "ms");
+    }
+
+    // segment index on a 2M-point ring, clipped to a z6 tile and its buffer 10 times
+    mapbox::geometry::linear_ring<double> coastline;
+    for (uint32_t i = 0; i < 2000000; ++i) {
+        const double t = 2 * M_PI * i / 2000000;
+        const double r = 30 + 3 * std::sin(t * 2000) * std::sin(t * 37);
+        coastline.emplace_back(10 + r * std::cos(t), 20 + 0.8 * r * std::sin(t));
+    }
+    coastline.push_back(coastline.front());
+    const mapbox::geojsonvt::feature_collection coast = {
+        { mapbox::geometry::polygon<double>{ coastline }, {} }
+    };
+    timer("prepare 2M-point ring");
+
+    for (const uint32_t min_points : { 0u, options.segmentIndexMinPoints }) {
+        const auto converted = mapbox::geojsonvt::detail::convert(
+            coast, 1e-9, mapbox::geojsonvt::Simplification::DouglasPeucker, nullptr, min_points);
+        const std::string name = min_points ? "with segment index" : "without segment index";
+        timer(name + ": convert");
+
+        const double size = 1.0 / 64;
+        const double p = size / 64;
+        std::size_t points = 0;
+        for (uint32_t i = 0; i < 10; ++i) {
+            const auto clipped = mapbox::geojsonvt::detail::clip<1>(
+                mapbox::geojsonvt::detail::clip<0>(converted, 38 * size - p, 39 * size + p, 0, 1),
+                25 * size - p, 26 * size + p, 0, 1);
+            points += clipped.empty() ? 0 : clipped[0].num_points;
+        }
+        timer(name + ": clip 10 times, " + std::to_string(points / 10) + " points");
+    }
+
+    // tile table throughput on all z10 tile ids in random order, against std::unordered_map
+    std::vector<uint64_t> ids;
+    std::vector<uint64_t> missing;
+    for (uint32_t x = 0; x < 1024; ++x) {
+        for (uint32_t y = 0; y < 1024; ++y) {
+            ids.push_back(mapbox::geojsonvt::toID(10, x, y));
+            missing.push_back(mapbox::geojsonvt::toID(11, x * 2, y * 2));
+        }
+    }
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(0));
+    std::shuffle(missing.begin(), missing.end(), std::mt19937(1));
+    timer("prepare 1M tile ids");
+
+    mapbox::geojsonvt::detail::TileMap<uint64_t> table;
+    for (const auto id : ids) {
+        table.emplace(id, uint64_t(id));
+    }
+    timer("TileMap: insert 1M ids");
+
+    uint64_t found = 0;
+    for (const auto id : ids) {
+        found += table.find(id) != table.end();
+    }
+    for (const auto id : missing) {
+        found += table.find(id) != table.end();
+    }
+    timer("TileMap: look up 1M ids and 1M missing ids, found " + std::to_string(found));
+
+    std::unordered_map<uint64_t, uint64_t> map;
+    for (const auto id : ids) {
+        map.emplace(id, id);
+    }
+    timer("std::unordered_map: insert 1M ids");
+
+    found = 0;
+    for (const auto id : ids) {
+        found += map.find(id) != map.end();
+    }
+    for (const auto id : missing) {
+        found += map.find(id) != map.end();
+    }
+    timer("std::unordered_map: look up 1M ids and 1M missing ids, found " +
+          std::to_string(found));
 }
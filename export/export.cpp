@@ -0,0 +1,367 @@
+#include <mapbox/geojson.hpp>
+#include <mapbox/geojsonvt.hpp>
+#include <mapbox/geojsonvt/thread_pool.hpp>
+
+#include "../bench/util.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include <sys/stat.h>
+
+using namespace mapbox::geojsonvt;
+
+// serializes tile content as GeoJSON in tile coordinates
+struct Stringify {
+    std::string& out;
+
+    void operator()(const mapbox::geometry::point<int16_t>& p) {
+        out += '[' + std::to_string(p.x) + ',' + std::to_string(p.y) + ']';
+    }
+
+    template <class T>
+    void operator()(const std::vector<T>& items) {
+        out += '[';
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (i)
+                out += ',';
+            operator()(items[i]);
+        }
+        out += ']';
+    }
+
+    void operator()(const mapbox::geometry::geometry<int16_t>& geometry) {
+        static const char* types[] = { "Point",      "LineString",      "Polygon",
+                                       "MultiPoint", "MultiLineString", "MultiPolygon" };
+        out += "{\"type\":\"";
+        out += types[geometry.which()];
+        out += "\",\"coordinates\":";
+        mapbox::geometry::geometry<int16_t>::visit(geometry, *this);
+        out += '}';
+    }
+
+    void operator()(const mapbox::geometry::geometry_collection<int16_t>&) {
+        out += "[]";
+    }
+
+    void operator()(const mapbox::geometry::value& value) {
+        mapbox::geometry::value::visit(value, *this);
+    }
+
+    void operator()(const bool value) {
+        out += value ? "true" : "false";
+    }
+
+    void operator()(const uint64_t value) {
+        out += std::to_string(value);
+    }
+
+    void operator()(const int64_t value) {
+        out += std::to_string(value);
+    }
+
+    void operator()(const double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        out += buffer;
+    }
+
+    void operator()(const std::string& value) {
+        out += '"';
+        for (const char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                out += buffer;
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    void operator()(const std::unordered_map<std::string, mapbox::geometry::value>& values) {
+        out += '{';
+        bool first = true;
+        for (const auto& pair : values) {
+            if (!first)
+                out += ',';
+            first = false;
+            operator()(pair.first);
+            out += ':';
+            operator()(pair.second);
+        }
+        out += '}';
+    }
+
+    void operator()(const mapbox::geometry::null_value_t&) {
+        out += "null";
+    }
+
+    void operator()(const Tile& tile) {
+        out += "{\"type\":\"FeatureCollection\",\"features\":[";
+        for (std::size_t i = 0; i < tile.features.size(); ++i) {
+            if (i)
+                out += ',';
+            out += "{\"type\":\"Feature\",\"geometry\":";
+            operator()(tile.features[i].geometry);
+            out += ",\"properties\":";
+            operator()(tile.features[i].properties);
+            out += '}';
+        }
+        out += "]}";
+    }
+};
+
+class Writer {
+public:
+    virtual ~Writer() = default;
+
+    // called concurrently from the threads generating tiles
+    virtual void write(uint8_t z, uint32_t x, uint32_t y, std::string data) = 0;
+
+    // waits until everything written so far is on disk
+    virtual void finish() {
+    }
+};
+
+// writes each tile to <dir>/<z>/<x>/<y>.json from the generating thread
+class DirectoryWriter : public Writer {
+public:
+    explicit DirectoryWriter(std::string dir_) : dir(std::move(dir_)) {
+        makeDirectory(dir);
+    }
+
+    void write(const uint8_t z, const uint32_t x, const uint32_t y, std::string data) override {
+        const std::string path = dir + "/" + std::to_string(z) + "/" + std::to_string(x);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (created.insert(path).second) {
+                makeDirectory(dir + "/" + std::to_string(z));
+                makeDirectory(path);
+            }
+        }
+
+        std::ofstream out(path + "/" + std::to_string(y) + ".json", std::ios::binary);
+        out.write(data.data(), data.size());
+        if (!out)
+            throw std::runtime_error("Error writing tile to " + path);
+    }
+
+private:
+    const std::string dir;
+    std::mutex mutex;
+    std::set<std::string> created;
+
+    static void makeDirectory(const std::string& path) {
+        if (::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+            throw std::runtime_error("Error creating directory " + path);
+    }
+};
+
+// appends tiles to a single file from a background thread, one line per tile:
+// {"z":0,"x":0,"y":0,"tile":<FeatureCollection>}
+class ArchiveWriter : public Writer {
+public:
+    explicit ArchiveWriter(const std::string& path)
+        : out(path, std::ios::binary), thread([this] { run(); }) {
+        if (!out)
+            throw std::runtime_error("Error opening " + path);
+    }
+
+    ~ArchiveWriter() override {
+        try {
+            finish();
+        } catch (...) {
+        }
+    }
+
+    void write(const uint8_t z, const uint32_t x, const uint32_t y, std::string data) override {
+        std::string line = "{\"z\":" + std::to_string(z) + ",\"x\":" + std::to_string(x) +
+                           ",\"y\":" + std::to_string(y) + ",\"tile\":" + data + "}\n";
+
+        std::unique_lock<std::mutex> lock(mutex);
+        // keep generation from running too far ahead of the disk
+        writable.wait(lock, [this] { return queue.size() < max_queued; });
+        queue.push_back(std::move(line));
+        readable.notify_one();
+    }
+
+    void finish() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished)
+                return;
+            finished = true;
+        }
+        readable.notify_one();
+        thread.join();
+        if (!out.flush())
+            throw std::runtime_error("Error writing archive");
+    }
+
+private:
+    static const std::size_t max_queued = 4096;
+
+    std::ofstream out;
+    std::deque<std::string> queue;
+    std::mutex mutex;
+    std::condition_variable readable;
+    std::condition_variable writable;
+    bool finished = false;
+    std::thread thread;
+
+    void run() {
+        while (true) {
+            std::deque<std::string> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                readable.wait(lock, [this] { return finished || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                batch.swap(queue);
+            }
+            writable.notify_all();
+            for (const auto& line : batch) {
+                out.write(line.data(), line.size());
+            }
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    const char* usage =
+        "usage: export <input.geojson> <output> [-z min_zoom] [-Z max_zoom] [-j threads] "
+        "[--archive]\n"
+        "writes all non-empty tiles to <output>/<z>/<x>/<y>.json, or to the single file <output> "
+        "with one tile per line when --archive is given\n";
+
+    std::string input;
+    std::string output;
+    uint8_t min_zoom = 0;
+    uint8_t max_zoom = 14;
+    unsigned threads = std::thread::hardware_concurrency();
+    bool archive = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "-z" && has_value) {
+            min_zoom = std::atoi(argv[++i]);
+        } else if (arg == "-Z" && has_value) {
+            max_zoom = std::atoi(argv[++i]);
+        } else if (arg == "-j" && has_value) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--archive") {
+            archive = true;
+        } else if (input.empty() && arg[0] != '-') {
+            input = arg;
+        } else if (output.empty() && arg[0] != '-') {
+            output = arg;
+        } else {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+
+    if (input.empty() || output.empty() || min_zoom > max_zoom || max_zoom > 24) {
+        std::cerr << usage;
+        return 1;
+    }
+    threads = std::max(threads, 1u);
+
+    Timer timer;
+
+    const std::string json = loadFile(input);
+    timer("read file");
+
+    const auto geojson = mapbox::geojson::parse(json);
+    timer("parse into geometry");
+
+    Options options;
+    options.maxZoom = max_zoom;
+    GeoJSONVT index{ geojson, options };
+    timer("generate tile index");
+
+    std::unique_ptr<Writer> writer;
+    if (archive)
+        writer = std::make_unique<ArchiveWriter>(output);
+    else
+        writer = std::make_unique<DirectoryWriter>(output);
+
+    const auto started = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> exported{ 0 };
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    const auto exportTile = [&](const uint8_t z, const uint32_t x, const uint32_t y,
+                                const Tile& tile) {
+        if (z < min_zoom)
+            return;
+        std::string data;
+        Stringify{ data }(tile);
+        writer->write(z, x, y, std::move(data));
+        exported++;
+    };
+
+    // subtrees rooted at this zoom are spread across the threads; a few per thread so that
+    // dense and sparse regions even out
+    uint8_t split_zoom = 0;
+    while (split_zoom < max_zoom && (1u << (2 * split_zoom)) < threads * 16) {
+        split_zoom++;
+    }
+
+    // the tiles above the split zoom, on this thread; any below the index's stored tiles are
+    // clipped like the ones in the subtrees
+    if (split_zoom > 0)
+        index.renderSubtree(0, 0, 0, split_zoom - 1, exportTile);
+
+    {
+        detail::ThreadPool pool(threads);
+
+        // each subtree is clipped from its own copy of the source features, so the threads
+        // only share the index for lookups; subtrees without source features return right away
+        const uint32_t n = 1u << split_zoom;
+        for (uint32_t i = 0; i < n * n; ++i) {
+            const uint32_t x = i % n;
+            const uint32_t y = i / n;
+            pool.schedule([&, x, y] {
+                try {
+                    index.renderSubtree(split_zoom, x, y, max_zoom, exportTile);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+            });
+        }
+    }
+
+    writer->finish();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    timer("export tiles z" + std::to_string(min_zoom) + "-" + std::to_string(max_zoom));
+    std::cerr << "exported " << exported << " tiles using " << threads << " threads, "
+              << static_cast<uint64_t>(exported / seconds) << " tiles/s\n";
+}
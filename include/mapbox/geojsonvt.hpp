@@ -1,14 +1,33 @@
 #pragma once
 
+#include <mapbox/geojsonvt/cancellation.hpp>
 #include <mapbox/geojsonvt/convert.hpp>
+#include <mapbox/geojsonvt/overzoom.hpp>
 #include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/tile_map.hpp>
+#include <mapbox/geojsonvt/thread_pool.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 #include <mapbox/geojsonvt/wrap.hpp>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cmath>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <future>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace mapbox {
 namespace geojsonvt {
@@ -47,11 +66,69 @@ struct Options {
     // simplification tolerance (higher means simpler)
     double tolerance = 3;
 
+    // simplification algorithm; with VisvalingamWhyatt, the tolerance squared is compared to
+    // triangle areas instead of squared distances, which keeps more points at the same value
+    Simplification simplification = Simplification::DouglasPeucker;
+
     // tile extent
     uint16_t extent = 4096;
 
     // tile buffer on each side
     uint16_t buffer = 64;
+
+    // max number of points per output tile; tiles above it are simplified further, then lose
+    // their least significant features (0 means no limit)
+    uint32_t tileMaxPoints = 0;
+
+    // max number of features per output tile (0 means no limit)
+    uint32_t tileMaxFeatures = 0;
+
+    // merge points below maxZoom into clusters on a grid of this size, in tile extent units
+    // (0 means no clustering)
+    uint16_t clusterRadius = 0;
+
+    // number of threads generating tiles for getTileAsync (0 means one per core)
+    uint16_t threads = 0;
+
+    // number of threads converting the input and clipping long feature lists in chunks, on a
+    // pool of their own (1 means on the calling thread only, 0 means one per core)
+    uint16_t chunkThreads = 1;
+
+    // whether tiles with identical content share a single Tile instance
+    bool dedupTiles = false;
+
+    // number of zoom levels past maxZoom to serve by clipping and scaling up the rendered
+    // maxZoom tiles (0 means getTile throws past maxZoom)
+    uint8_t overzoom = 0;
+
+    // max number of overzoomed tiles kept for later requests; the oldest ones are dropped first
+    // (0 means none are kept)
+    uint32_t overzoomCacheSize = 4096;
+
+    // drill down to requested tiles without storing the tiles in between; only the source
+    // features at zoom levels that are a multiple of drillDownCheckpoint are kept, so that
+    // later requests nearby can start from there (0 means no checkpoints)
+    bool transientDrillDown = false;
+    uint8_t drillDownCheckpoint = 4;
+
+    // lines and rings with at least this many points get an index of the bboxes of runs of
+    // their segments, so that clipping them skips the runs outside a tile; the parts that are
+    // clipped out of them keep an index as long as they are that large (0 means no index)
+    uint32_t segmentIndexMinPoints = 4096;
+
+    // reorder the input features along a Hilbert curve, so that features that end up in the
+    // same tiles are close in memory; changes the order of features within tiles
+    bool hilbertOrder = false;
+
+    // transform the points of tiles at this zoom and deeper in fixed point, which is a little
+    // cheaper and matches the floating point output within one tile unit, with ties rounded up
+    // instead of away from zero (0 means never)
+    uint8_t fixedPointMinZoom = 0;
+
+    // keep the tiles ordered by toQuadkeyID as well, for the subtree operations countTiles,
+    // forEachTile and evictTiles; evictTiles also needs transientDrillDown, since otherwise the
+    // tiles above the evicted ones don't keep the source features to render them again from
+    bool orderedTiles = false;
 };
 
 const Tile empty_tile{};
@@ -60,18 +137,85 @@ inline uint64_t toID(uint8_t z, uint32_t x, uint32_t y) {
     return (((1ull << z) * y + x) * 32) + z;
 }
 
+namespace detail {
+
+// spreads the bits of v out to the even bit positions
+inline uint64_t interleave(const uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+// the deepest stored ancestor of the tile, or the end of the map; tiles are only created by
+// splitting their parent, so all ancestors of an existing tile exist as well and the deepest one
+// can be found by binary search over the zoom levels
+template <class T>
+typename TileMap<T>::iterator
+findParent(TileMap<T>& tiles, const uint8_t z, const uint32_t x, const uint32_t y) {
+    const auto end = tiles.end();
+    auto parent = end;
+
+    uint8_t min = 0;
+    uint8_t max = z;
+    while (min < max) {
+        const uint8_t z0 = (min + max) / 2;
+        const auto it = tiles.find(toID(z0, x >> (z - z0), y >> (z - z0)));
+        if (it != end) {
+            parent = it;
+            min = z0 + 1;
+        } else {
+            max = z0;
+        }
+    }
+
+    return parent;
+}
+
+// the pool for Options::chunkThreads, or none if chunks run on the calling thread only
+inline std::unique_ptr<ThreadPool> makeChunkPool(const uint16_t chunkThreads) {
+    const unsigned n = chunkThreads != 0 ? chunkThreads : std::thread::hardware_concurrency();
+    return n > 1 ? std::make_unique<ThreadPool>(n) : std::unique_ptr<ThreadPool>();
+}
+
+} // namespace detail
+
+// Z-order tile id for zooms up to 29: the quadkey of the tile in the upper 58 bits, padded
+// with zeros, and the zoom in the lower 5 bits; a tile and all of its descendants have ids in
+// the range [toQuadkeyID(z, x, y), toQuadkeyIDEnd(z, x, y))
+inline uint64_t toQuadkeyID(uint8_t z, uint32_t x, uint32_t y) {
+    return ((detail::interleave(x) | (detail::interleave(y) << 1)) << (63 - 2 * z)) | z;
+}
+
+inline uint64_t toQuadkeyIDEnd(uint8_t z, uint32_t x, uint32_t y) {
+    return ((detail::interleave(x) | (detail::interleave(y) << 1)) + 1) << (63 - 2 * z);
+}
+
 class GeoJSONVT {
 public:
     const Options options;
 
     GeoJSONVT(const mapbox::geometry::feature_collection<double>& features_,
               const Options& options_ = Options())
-        : options(options_) {
+        : options(options_),
+          threads(options.threads != 0 ? options.threads : std::thread::hardware_concurrency()),
+          chunkPool(detail::makeChunkPool(options.chunkThreads)) {
+
+        if (options.maxZoom > 29)
+            throw std::runtime_error("maxZoom can be at most 29");
 
         const uint32_t z2 = std::pow(2, options.maxZoom);
 
-        auto converted = detail::convert(features_, (options.tolerance / options.extent) / z2);
-        auto features = detail::wrap(converted, double(options.buffer) / options.extent);
+        auto converted = detail::convert(features_, (options.tolerance / options.extent) / z2,
+                                         options.simplification, chunkPool.get(),
+                                         options.segmentIndexMinPoints);
+        if (options.hilbertOrder)
+            detail::sortByHilbert(converted);
+        auto features = detail::wrap(std::move(converted),
+                                     double(options.buffer) / options.extent, chunkPool.get());
 
         splitTile(features, 0, 0, 0);
     }
@@ -80,23 +224,347 @@ public:
         : GeoJSONVT(geojson::visit(geojson_, ToFeatureCollection{}), options_) {
     }
 
+    // number of tiles kept by zoom and in total, overzoomed ones included
     std::map<uint8_t, uint32_t> stats;
     uint32_t total = 0;
 
-    const Tile& getTile(const uint8_t z, const uint32_t x_, const uint32_t y) {
+    // estimated memory of all rendered tiles, and what is left of it after deduplication; only
+    // counted with options.dedupTiles, since it takes a pass over every tile
+    uint64_t tileBytes = 0;
+    uint64_t uniqueTileBytes = 0;
 
-        if (z > options.maxZoom)
+    // safe to call from several threads at once; tiles that are already generated are looked
+    // up concurrently, while drilling down to new tiles happens one request at a time. The tile
+    // stays valid until it is evicted with evictTiles; use getSharedTile to hold on to tiles
+    // that may be evicted meanwhile
+    const Tile& getTile(const uint8_t z, const uint32_t x, const uint32_t y) {
+        return *getSharedTile(z, x, y, nullptr);
+    }
+
+    // throws CanceledError if the token is canceled before the tile is ready; tiles from the
+    // levels that were completed until then are kept for later requests
+    const Tile&
+    getTile(const uint8_t z, const uint32_t x, const uint32_t y, const CancellationToken& cancel) {
+        return *getSharedTile(z, x, y, &cancel);
+    }
+
+    // like getTile, but shares ownership of the tile, so that it outlives evictTiles
+    std::shared_ptr<const Tile> getSharedTile(const uint8_t z, const uint32_t x, const uint32_t y) {
+        return getSharedTile(z, x, y, nullptr);
+    }
+
+    std::shared_ptr<const Tile> getSharedTile(const uint8_t z,
+                                              const uint32_t x,
+                                              const uint32_t y,
+                                              const CancellationToken& cancel) {
+        return getSharedTile(z, x, y, &cancel);
+    }
+
+    // generates the tile on the internal thread pool; the future rethrows getTile errors
+    std::future<std::shared_ptr<const Tile>> getTileAsync(const uint8_t z,
+                                                          const uint32_t x,
+                                                          const uint32_t y,
+                                                          const CancellationToken cancel = {}) {
+        auto task = std::make_shared<std::packaged_task<std::shared_ptr<const Tile>()>>(
+            [this, z, x, y, cancel] { return getSharedTile(z, x, y, cancel); });
+        auto result = task->get_future();
+        getPool().schedule([task] { (*task)(); });
+        return result;
+    }
+
+    // runs the callback on a pool thread once the tile is ready; if generating it failed, the
+    // callback gets the error and an empty tile. The tile is only kept alive during the callback
+    void getTileAsync(const uint8_t z,
+                      const uint32_t x,
+                      const uint32_t y,
+                      std::function<void(std::exception_ptr, const Tile&)> callback,
+                      const CancellationToken cancel = {}) {
+        getPool().schedule([this, z, x, y, callback, cancel] {
+            std::shared_ptr<const Tile> tile = emptyTile;
+            std::exception_ptr error;
+            try {
+                tile = getSharedTile(z, x, y, cancel);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            callback(error, *tile);
+        });
+    }
+
+    // not synchronized with getTile or getTileAsync calls that are still running
+    const detail::TileMap<detail::InternalTile>& getInternalTiles() const {
+        return tiles;
+    }
+
+    // number of stored tiles in the subtree of the given tile, including itself; needs
+    // options.orderedTiles like the other subtree operations
+    std::size_t countTiles(const uint8_t z, const uint32_t x, const uint32_t y) {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        const auto range = subtree(z, x, y);
+        return std::distance(range.first, range.second);
+    }
+
+    // calls back with every stored tile in the subtree of the given tile, in Z-order
+    void forEachTile(const uint8_t z,
+                     const uint32_t x,
+                     const uint32_t y,
+                     const std::function<void(const detail::InternalTile&)>& callback) {
+        std::shared_lock<std::shared_timed_mutex> lock(mutex);
+        const auto range = subtree(z, x, y);
+        for (auto it = range.first; it != range.second; ++it) {
+            callback(*it->second);
+        }
+    }
+
+    // removes the stored tiles below the given tile, along with the checkpoints, empty regions
+    // and overzoomed tiles below it, and returns how many stored tiles there were; they are
+    // rendered again on request from the closest tile above that still has its source features,
+    // which is why this needs options.transientDrillDown and throws when that is a tile that
+    // has been split (always the case with tiles in the tile index). References returned by
+    // getTile for the evicted tiles become invalid, unlike the tiles from getSharedTile
+    std::size_t evictTiles(const uint8_t z, const uint32_t x, const uint32_t y) {
+        if (!options.transientDrillDown)
+            throw std::runtime_error("Evicting tiles needs options.transientDrillDown");
+
+        std::lock_guard<std::shared_timed_mutex> lock(mutex);
+        auto range = subtree(z, x, y);
+
+        for (uint8_t z0 = z;; --z0) {
+            const uint64_t id0 = toID(z0, x >> (z - z0), y >> (z - z0));
+            const uint64_t key0 = toQuadkeyID(z0, x >> (z - z0), y >> (z - z0));
+            if (checkpoints.count(key0))
+                break;
+
+            const auto it = tiles.find(id0);
+            if (it != tiles.end()) {
+                const auto& tile = it->second;
+                if (tile.source_features.empty() && !emptyTiles.count(key0) &&
+                    !(tile.is_solid && !options.solidChildren))
+                    throw std::runtime_error("Can't evict the tiles below a split tile");
+                break;
+            }
+
+            if (z0 == 0)
+                break;
+        }
+
+        if (range.first != range.second && range.first->first == toQuadkeyID(z, x, y))
+            ++range.first;
+
+        std::size_t evicted = 0;
+        for (auto it = range.first; it != range.second; ++it) {
+            const auto& tile = *it->second;
+            releaseTile(tile);
+            if (--stats[tile.z] == 0)
+                stats.erase(tile.z);
+            total--;
+            tiles.erase(toID(tile.z, tile.x, tile.y));
+            evicted++;
+        }
+        orderedTiles.erase(range.first, range.second);
+
+        // the entries below the tile, but not the tile's own
+        const uint64_t first = toQuadkeyID(z, x, y) + 1;
+        const uint64_t last = toQuadkeyIDEnd(z, x, y);
+        checkpoints.erase(checkpoints.lower_bound(first), checkpoints.lower_bound(last));
+        emptyTiles.erase(emptyTiles.lower_bound(first), emptyTiles.lower_bound(last));
+        for (auto it = overzoomed.begin(); it != overzoomed.end();) {
+            if (it->z > z && it->x >> (it->z - z) == x && it->y >> (it->z - z) == y)
+                it = dropOverzoomedTile(it);
+            else
+                ++it;
+        }
+
+        return evicted;
+    }
+
+    using SubtreeCallback = std::function<void(uint8_t, uint32_t, uint32_t, const Tile&)>;
+
+    // calls back with every tile that has features in the subtree of the given tile, down to
+    // maxZ; the tiles below the stored ones are rendered from the closest stored source features
+    // into private lists and are not stored, so several threads can render separate subtrees at
+    // once while only sharing the lock for lookups; a solid clipped square is passed on for each
+    // of its descendants, as getTile returns it for them
+    void renderSubtree(const uint8_t z,
+                       const uint32_t x,
+                       const uint32_t y,
+                       const uint8_t maxZ,
+                       const SubtreeCallback& callback) {
+        if (maxZ > options.maxZoom)
+            throw std::runtime_error("Requested zoom higher than maxZoom: " +
+                                     std::to_string(maxZ));
+
+        std::shared_ptr<const Tile> stored;
+        bool solid = false;
+        bool split = false;
+        detail::vt_features features;
+        std::array<detail::vt_features, 4> children;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(mutex);
+            const uint64_t id = toID(z, x, y);
+            if (isEmpty(z, x, y))
+                return;
+
+            const auto it = tiles.find(id);
+            if (it != tiles.end()) {
+                const auto& tile = it->second;
+                stored = tile.tile;
+                solid = !options.solidChildren && tile.is_solid;
+                split = tile.source_features.empty();
+                if (!solid && !split && z < maxZ)
+                    children = clipChildren(tile.source_features, tile.bbox, z, x, y);
+
+            } else {
+                // clip the source features of the closest ancestor down to the tile
+                const detail::vt_features* source = nullptr;
+                for (uint8_t z0 = z - 1;; --z0) {
+                    const uint64_t id0 = toID(z0, x >> (z - z0), y >> (z - z0));
+
+                    const auto checkpoint =
+                        checkpoints.find(toQuadkeyID(z0, x >> (z - z0), y >> (z - z0)));
+                    if (checkpoint != checkpoints.end()) {
+                        source = &checkpoint->second;
+                    } else {
+                        const auto parent = tiles.find(id0);
+                        if (parent != tiles.end()) {
+                            if (!options.solidChildren && parent->second.is_solid) {
+                                stored = parent->second.tile;
+                                solid = true;
+                                break;
+                            }
+                            source = &parent->second.source_features;
+                        }
+                    }
+
+                    if (source) {
+                        for (uint8_t cz = z0 + 1; cz <= z && !source->empty(); ++cz) {
+                            features = clipChild(*source, cz, x >> (z - cz), y >> (z - cz),
+                                                 nullptr);
+                            source = &features;
+                        }
+                        break;
+                    }
+
+                    if (z0 == 0)
+                        throw std::runtime_error("Parent tile not found");
+                }
+            }
+        }
+
+        if (solid) {
+            renderSolid(*stored, z, x, y, maxZ, callback);
+            return;
+        }
+
+        if (!stored) {
+            if (!features.empty())
+                renderFeatures(features, z, x, y, maxZ, callback);
+            return;
+        }
+
+        // the children of a split tile are stored as well, the others are clipped from its
+        // source features
+
+        if (!stored->features.empty())
+            callback(z, x, y, *stored);
+        if (z == maxZ)
+            return;
+
+        for (uint32_t i = 0; i < 4; ++i) {
+            const uint32_t cx = x * 2 + i / 2;
+            const uint32_t cy = y * 2 + i % 2;
+            if (split)
+                renderSubtree(z + 1, cx, cy, maxZ, callback);
+            else if (!children[i].empty())
+                renderFeatures(children[i], z + 1, cx, cy, maxZ, callback);
+        }
+    }
+
+private:
+    // threads for getTileAsync
+    const unsigned threads;
+
+    // threads for converting the input and clipping long feature lists, if there is more than one
+    const std::unique_ptr<detail::ThreadPool> chunkPool;
+
+    detail::TileMap<detail::InternalTile> tiles;
+
+    // roots of subtrees without any features, so that requests below them return right away;
+    // by toQuadkeyID like checkpoints, so that evictTiles can find the ones in a subtree
+    std::set<uint64_t> emptyTiles;
+
+    // the same tiles by toQuadkeyID, if options.orderedTiles is set
+    std::map<uint64_t, detail::InternalTile*> orderedTiles;
+
+    // source features of unrendered tiles kept by transient drill-downs, by toQuadkeyID
+    std::map<uint64_t, detail::vt_features> checkpoints;
+
+    struct OverzoomedTile {
+        uint8_t z;
+        uint32_t x;
+        uint32_t y;
+        std::shared_ptr<const Tile> tile;
+    };
+
+    // tiles past maxZoom, rendered from their maxZoom ancestor, oldest first
+    std::list<OverzoomedTile> overzoomed;
+
+    // the same tiles by toID
+    std::unordered_map<uint64_t, std::list<OverzoomedTile>::iterator> overzoomedIDs;
+
+    // rendered tiles by content hash, with the number of stored tiles sharing each
+    std::unordered_map<std::size_t, std::vector<std::pair<std::shared_ptr<Tile>, std::size_t>>>
+        uniqueTiles;
+
+    // does not own the shared empty tile
+    const std::shared_ptr<const Tile> emptyTile{ std::shared_ptr<const Tile>(), &empty_tile };
+
+    std::shared_timed_mutex mutex;
+
+    // declared last so that pending tasks finish before the tiles go away
+    std::once_flag poolCreated;
+    std::unique_ptr<detail::ThreadPool> pool;
+
+    detail::ThreadPool& getPool() {
+        std::call_once(poolCreated,
+                       [this] { pool = std::make_unique<detail::ThreadPool>(threads); });
+        return *pool;
+    }
+
+    std::shared_ptr<const Tile> getSharedTile(const uint8_t z,
+                                              const uint32_t x_,
+                                              const uint32_t y,
+                                              const CancellationToken* cancel) {
+
+        if (z > options.maxZoom + options.overzoom)
             throw std::runtime_error("Requested zoom higher than maxZoom: " + std::to_string(z));
 
         const uint32_t z2 = std::pow(2, z);
         const uint32_t x = ((x_ % z2) + z2) % z2; // wrap tile x coordinate
         const uint64_t id = toID(z, x, y);
 
+        if (z > options.maxZoom)
+            return getOverzoomedTile(z, x, y, id, cancel);
+
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(mutex);
+            auto it = tiles.find(id);
+            if (it != tiles.end())
+                return it->second.tile;
+            if (isEmpty(z, x, y))
+                return emptyTile;
+        }
+
+        std::lock_guard<std::shared_timed_mutex> lock(mutex);
+
         auto it = tiles.find(id);
         if (it != tiles.end())
             return it->second.tile;
 
-        it = findParent(z, x, y);
+        if (options.transientDrillDown)
+            return drillDown(z, x, y, cancel);
+
+        it = detail::findParent(tiles, z, x, y);
 
         if (it == tiles.end())
             throw std::runtime_error("Parent tile not found");
@@ -109,13 +577,13 @@ public:
             return parent.tile;
 
         // drill down parent tile up to the requested one
-        splitTile(parent.source_features, parent.z, parent.x, parent.y, z, x, y);
+        splitTile(parent.source_features, parent.z, parent.x, parent.y, z, x, y, cancel);
 
         it = tiles.find(id);
         if (it != tiles.end())
             return it->second.tile;
 
-        it = findParent(z, x, y);
+        it = detail::findParent(tiles, z, x, y);
         if (it == tiles.end())
             throw std::runtime_error("Parent tile not found");
 
@@ -124,33 +592,341 @@ public:
             return it->second.tile;
 
         // otherwise it was an empty tile
-        return empty_tile;
+        return emptyTile;
     }
 
-    const std::unordered_map<uint64_t, detail::InternalTile>& getInternalTiles() const {
-        return tiles;
-    }
+    // clip the features of the closest ancestor down to the requested tile level by level,
+    // keeping only checkpoints and the requested tile itself
+    std::shared_ptr<const Tile> drillDown(const uint8_t z,
+                                          const uint32_t x,
+                                          const uint32_t y,
+                                          const CancellationToken* cancel) {
+        const detail::vt_features* source = nullptr;
+        uint8_t z0 = z;
 
-private:
-    std::unordered_map<uint64_t, detail::InternalTile> tiles;
+        while (true) {
+            const uint64_t id0 = toID(z0, x >> (z - z0), y >> (z - z0));
 
-    std::unordered_map<uint64_t, detail::InternalTile>::iterator
-    findParent(const uint8_t z, const uint32_t x, const uint32_t y) {
-        uint8_t z0 = z;
-        uint32_t x0 = x;
-        uint32_t y0 = y;
+            const auto checkpoint =
+                checkpoints.find(toQuadkeyID(z0, x >> (z - z0), y >> (z - z0)));
+            if (checkpoint != checkpoints.end()) {
+                source = &checkpoint->second;
+                break;
+            }
 
-        const auto end = tiles.end();
-        auto parent = end;
+            const auto it = tiles.find(id0);
+            if (it != tiles.end()) {
+                // a solid clipped square is identical to all of its descendants
+                if (it->second.is_solid)
+                    return it->second.tile;
+                source = &it->second.source_features;
+                break;
+            }
 
-        while ((parent == end) && (z0 != 0)) {
+            if (z0 == 0)
+                throw std::runtime_error("Parent tile not found");
             z0--;
-            x0 = x0 / 2;
-            y0 = y0 / 2;
-            parent = tiles.find(toID(z0, x0, y0));
         }
 
-        return parent;
+        detail::vt_features features;
+        const detail::vt_features* current = source;
+
+        if (current->empty())
+            return emptyTile;
+
+        for (uint8_t cz = z0 + 1; cz <= z; ++cz) {
+            const uint32_t cx = x >> (z - cz);
+            const uint32_t cy = y >> (z - cz);
+            features = clipChild(*current, cz, cx, cy, cancel);
+            current = &features;
+
+            if (features.empty()) {
+                emptyTiles.insert(toQuadkeyID(cz, cx, cy));
+                return emptyTile;
+            }
+
+            if (cz < z && options.drillDownCheckpoint != 0 &&
+                cz % options.drillDownCheckpoint == 0)
+                checkpoints.emplace(toQuadkeyID(cz, cx, cy), features);
+        }
+
+        // the requested tile keeps its source features for deeper requests, like in splitTile
+        auto tile = addTile(*current, z, x, y);
+        tile->second.source_features = *current;
+        checkpoints.erase(toQuadkeyID(z, x, y));
+
+        return tile->second.tile;
+    }
+
+    // the features of the parent tile at cz - 1 that fall into the tile cz/cx/cy, clipped the
+    // same way splitTile does
+    detail::vt_features clipChild(const detail::vt_features& features,
+                                  const uint8_t cz,
+                                  const uint32_t cx,
+                                  const uint32_t cy,
+                                  const CancellationToken* cancel) const {
+        if (cancel)
+            cancel->check();
+
+        const double p = 0.5 * options.buffer / options.extent;
+        const double z2 = 1u << (cz - 1);
+        const double x0 = (cx / 2) + (cx % 2 == 0 ? -p : 0.5 - p);
+        const double x1 = (cx / 2) + (cx % 2 == 0 ? 0.5 + p : 1 + p);
+        const double y0 = (cy / 2) + (cy % 2 == 0 ? -p : 0.5 - p);
+        const double y1 = (cy / 2) + (cy % 2 == 0 ? 0.5 + p : 1 + p);
+
+        mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
+        for (const auto& feature : features) {
+            bbox.min.x = std::min(feature.bbox.min.x, bbox.min.x);
+            bbox.min.y = std::min(feature.bbox.min.y, bbox.min.y);
+            bbox.max.x = std::max(feature.bbox.max.x, bbox.max.x);
+            bbox.max.y = std::max(feature.bbox.max.y, bbox.max.y);
+        }
+
+        const double t = getTolerance(cz);
+        return detail::clip<1>(detail::clip<0>(features, x0 / z2, x1 / z2, bbox.min.x,
+                                               bbox.max.x, t, cancel, chunkPool.get()),
+                               y0 / z2, y1 / z2, bbox.min.y, bbox.max.y, t, cancel,
+                               chunkPool.get());
+    }
+
+    // the features of the four children of the tile, in the order splitTile visits them
+    std::array<detail::vt_features, 4> clipChildren(const detail::vt_features& features,
+                                                    const mapbox::geometry::box<double>& bbox,
+                                                    const uint8_t z,
+                                                    const uint32_t x,
+                                                    const uint32_t y) const {
+        const double p = 0.5 * options.buffer / options.extent;
+        const double z2 = 1u << z;
+        const double t = getTolerance(z + 1);
+        const auto& min = bbox.min;
+        const auto& max = bbox.max;
+
+        const auto left = detail::clip<0>(features, (x - p) / z2, (x + 0.5 + p) / z2, min.x,
+                                          max.x, t, nullptr, chunkPool.get());
+        const auto right = detail::clip<0>(features, (x + 0.5 - p) / z2, (x + 1 + p) / z2,
+                                           min.x, max.x, t, nullptr, chunkPool.get());
+        return { { detail::clip<1>(left, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y, t,
+                                   nullptr, chunkPool.get()),
+                   detail::clip<1>(left, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y, t,
+                                   nullptr, chunkPool.get()),
+                   detail::clip<1>(right, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y, t,
+                                   nullptr, chunkPool.get()),
+                   detail::clip<1>(right, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y, t,
+                                   nullptr, chunkPool.get()) } };
+    }
+
+    // renders the tile from its features and its subtree below it, without storing anything
+    void renderFeatures(const detail::vt_features& features,
+                        const uint8_t z,
+                        const uint32_t x,
+                        const uint32_t y,
+                        const uint8_t maxZ,
+                        const SubtreeCallback& callback) const {
+        const detail::InternalTile tile{ features,
+                                         z,
+                                         x,
+                                         y,
+                                         options.extent,
+                                         options.buffer,
+                                         getTolerance(z),
+                                         options.tileMaxPoints,
+                                         options.tileMaxFeatures,
+                                         getClusterRadius(z),
+                                         useFixedPoint(z) };
+
+        if (!options.solidChildren && tile.is_solid) {
+            renderSolid(*tile.tile, z, x, y, maxZ, callback);
+            return;
+        }
+
+        if (!tile.tile->features.empty())
+            callback(z, x, y, *tile.tile);
+        if (z == maxZ)
+            return;
+
+        const auto children = clipChildren(features, tile.bbox, z, x, y);
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (!children[i].empty())
+                renderFeatures(children[i], z + 1, x * 2 + i / 2, y * 2 + i % 2, maxZ, callback);
+        }
+    }
+
+    // a solid clipped square stands for all of its descendants, like in getTile
+    static void renderSolid(const Tile& tile,
+                            const uint8_t z,
+                            const uint32_t x,
+                            const uint32_t y,
+                            const uint8_t maxZ,
+                            const SubtreeCallback& callback) {
+        callback(z, x, y, tile);
+        if (z == maxZ)
+            return;
+        for (uint32_t i = 0; i < 4; ++i) {
+            renderSolid(tile, z + 1, x * 2 + i / 2, y * 2 + i % 2, maxZ, callback);
+        }
+    }
+
+    std::shared_ptr<const Tile> getOverzoomedTile(const uint8_t z,
+                                                  const uint32_t x,
+                                                  const uint32_t y,
+                                                  const uint64_t id,
+                                                  const CancellationToken* cancel) {
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(mutex);
+            auto it = overzoomedIDs.find(id);
+            if (it != overzoomedIDs.end())
+                return it->second->tile;
+        }
+
+        const uint8_t dz = z - options.maxZoom;
+        const auto parent = getSharedTile(options.maxZoom, x >> dz, y >> dz, cancel);
+        if (parent->features.empty())
+            return emptyTile;
+
+        // the parent tile doesn't change once rendered and is kept alive here even if it is
+        // evicted meanwhile, so no lock is needed until the result is stored
+        auto tile = std::make_shared<const Tile>(
+            detail::overzoomTile(*parent, dz, x - ((x >> dz) << dz), y - ((y >> dz) << dz),
+                                 options.extent, options.buffer, cancel));
+
+        if (options.overzoomCacheSize == 0)
+            return tile;
+
+        std::lock_guard<std::shared_timed_mutex> lock(mutex);
+
+        // another request may have rendered it meanwhile
+        auto it = overzoomedIDs.find(id);
+        if (it != overzoomedIDs.end())
+            return it->second->tile;
+
+        overzoomed.push_back({ z, x, y, tile });
+        overzoomedIDs.emplace(id, std::prev(overzoomed.end()));
+        stats[z] = (stats.count(z) ? stats[z] + 1 : 1);
+        total++;
+        if (options.dedupTiles) {
+            // overzoomed tiles are not deduplicated
+            const auto bytes = detail::tileBytes(*tile);
+            tileBytes += bytes;
+            uniqueTileBytes += bytes;
+        }
+
+        while (overzoomed.size() > options.overzoomCacheSize) {
+            dropOverzoomedTile(overzoomed.begin());
+        }
+
+        return tile;
+    }
+
+    // removes the tile from the overzoomed tiles and the counts, and returns the next one
+    std::list<OverzoomedTile>::iterator
+    dropOverzoomedTile(const std::list<OverzoomedTile>::iterator it) {
+        if (--stats[it->z] == 0)
+            stats.erase(it->z);
+        total--;
+        if (options.dedupTiles) {
+            const auto bytes = detail::tileBytes(*it->tile);
+            tileBytes -= bytes;
+            uniqueTileBytes -= bytes;
+        }
+        overzoomedIDs.erase(toID(it->z, it->x, it->y));
+        return overzoomed.erase(it);
+    }
+
+    // make the tile share its content with an identical one that was rendered before
+    void dedupTile(detail::InternalTile& tile) {
+        if (!options.dedupTiles)
+            return;
+
+        const auto bytes = detail::tileBytes(*tile.tile);
+        tileBytes += bytes;
+
+        auto& candidates = uniqueTiles[detail::hashTile(*tile.tile)];
+        for (auto& candidate : candidates) {
+            if (detail::equalTiles(*candidate.first, *tile.tile)) {
+                tile.tile = candidate.first;
+                candidate.second++;
+                return;
+            }
+        }
+        candidates.emplace_back(tile.tile, 1);
+
+        uniqueTileBytes += bytes;
+    }
+
+    std::pair<std::map<uint64_t, detail::InternalTile*>::iterator,
+              std::map<uint64_t, detail::InternalTile*>::iterator>
+    subtree(const uint8_t z, const uint32_t x, const uint32_t y) {
+        if (!options.orderedTiles)
+            throw std::runtime_error("Subtree operations need options.orderedTiles");
+
+        return { orderedTiles.lower_bound(toQuadkeyID(z, x, y)),
+                 orderedTiles.lower_bound(toQuadkeyIDEnd(z, x, y)) };
+    }
+
+    // undo the memory accounting of dedupTile for a tile that is about to be erased
+    void releaseTile(const detail::InternalTile& tile) {
+        if (!options.dedupTiles)
+            return;
+
+        const auto bytes = detail::tileBytes(*tile.tile);
+        tileBytes -= bytes;
+
+        // the content goes away with the last stored tile that uses it; callers may still hold
+        // on to it through getSharedTile
+        auto& candidates = uniqueTiles[detail::hashTile(*tile.tile)];
+        const auto candidate =
+            std::find_if(candidates.begin(), candidates.end(),
+                         [&](const auto& unique) { return unique.first == tile.tile; });
+        if (--candidate->second == 0) {
+            candidates.erase(candidate);
+            uniqueTileBytes -= bytes;
+        }
+    }
+
+    // whether the tile lies in a subtree that is known to have no features
+    bool isEmpty(const uint8_t z, const uint32_t x, const uint32_t y) const {
+        if (emptyTiles.empty())
+            return false;
+
+        for (uint8_t z0 = z;; --z0) {
+            if (emptyTiles.count(toQuadkeyID(z0, x >> (z - z0), y >> (z - z0))))
+                return true;
+            if (z0 == 0)
+                return false;
+        }
+    }
+
+    // simplification tolerance of tiles at the given zoom, in world units
+    double getTolerance(const uint8_t z) const {
+        const double z2 = 1u << z;
+        return z == options.maxZoom ? 0 : options.tolerance / (z2 * options.extent);
+    }
+
+    // points keep full detail at maxZoom
+    uint16_t getClusterRadius(const uint8_t z) const {
+        return z == options.maxZoom ? 0 : options.clusterRadius;
+    }
+
+    bool useFixedPoint(const uint8_t z) const {
+        return options.fixedPointMinZoom != 0 && z >= options.fixedPointMinZoom;
+    }
+
+    detail::TileMap<detail::InternalTile>::iterator addTile(
+        const detail::vt_features& features, const uint8_t z, const uint32_t x, const uint32_t y) {
+        auto it = tiles
+                      .emplace(toID(z, x, y),
+                               detail::InternalTile{ features, z, x, y, options.extent,
+                                                     options.buffer, getTolerance(z),
+                                                     options.tileMaxPoints, options.tileMaxFeatures,
+                                                     getClusterRadius(z), useFixedPoint(z) })
+                      .first;
+        stats[z] = (stats.count(z) ? stats[z] + 1 : 1);
+        total++;
+        dedupTile(it->second);
+        if (options.orderedTiles)
+            orderedTiles.emplace(toQuadkeyID(z, x, y), &it->second);
+        return it;
     }
 
     void splitTile(const detail::vt_features& features,
@@ -159,7 +935,11 @@ private:
                    const uint32_t y,
                    const uint8_t cz = 0,
                    const uint32_t cx = 0,
-                   const uint32_t cy = 0) {
+                   const uint32_t cy = 0,
+                   const CancellationToken* cancel = nullptr) {
+
+        if (cancel)
+            cancel->check();
 
         const double z2 = 1u << z;
         const uint64_t id = toID(z, x, y);
@@ -167,15 +947,9 @@ private:
         auto it = tiles.find(id);
 
         if (it == tiles.end()) {
-            const double tolerance =
-                (z == options.maxZoom ? 0 : options.tolerance / (z2 * options.extent));
-
-            it = tiles
-                     .emplace(id, detail::InternalTile{ features, z, x, y, options.extent,
-                                                        options.buffer, tolerance })
-                     .first;
-            stats[z] = (stats.count(z) ? stats[z] + 1 : 1);
-            total++;
+            it = addTile(features, z, x, y);
+            if (features.empty())
+                emptyTiles.insert(toQuadkeyID(z, x, y));
             // printf("tile z%i-%i-%i\n", z, x, y);
         }
 
@@ -191,7 +965,7 @@ private:
         // if it's the first-pass tiling
         if (cz == 0u) {
             // stop tiling if we reached max zoom, or if the tile is too simple
-            if (z == options.indexMaxZoom || tile.tile.num_points <= options.indexMaxPoints) {
+            if (z == options.indexMaxZoom || tile.tile->num_points <= options.indexMaxPoints) {
                 tile.source_features = features;
                 return;
             }
@@ -220,20 +994,316 @@ private:
         const auto& min = tile.bbox.min;
         const auto& max = tile.bbox.max;
 
-        const auto left = detail::clip<0>(features, (x - p) / z2, (x + 0.5 + p) / z2, min.x, max.x);
+        // features that are invisible in the children are carried down without clipping
+        const double t = getTolerance(z + 1);
+
+        try {
+            const auto left = detail::clip<0>(features, (x - p) / z2, (x + 0.5 + p) / z2, min.x,
+                                              max.x, t, cancel, chunkPool.get());
+
+            splitTile(detail::clip<1>(left, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y, t,
+                                      cancel, chunkPool.get()),
+                      z + 1, x * 2, y * 2, cz, cx, cy, cancel);
+            splitTile(detail::clip<1>(left, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y,
+                                      t, cancel, chunkPool.get()),
+                      z + 1, x * 2, y * 2 + 1, cz, cx, cy, cancel);
+
+            const auto right = detail::clip<0>(features, (x + 0.5 - p) / z2, (x + 1 + p) / z2,
+                                               min.x, max.x, t, cancel, chunkPool.get());
+
+            splitTile(detail::clip<1>(right, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y, t,
+                                      cancel, chunkPool.get()),
+                      z + 1, x * 2 + 1, y * 2, cz, cx, cy, cancel);
+            splitTile(detail::clip<1>(right, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y,
+                                      t, cancel, chunkPool.get()),
+                      z + 1, x * 2 + 1, y * 2 + 1, cz, cx, cy, cancel);
+
+        } catch (const CanceledError&) {
+            // keep the source geometry, so that later requests can drill down from here
+            tile.source_features = features;
+            throw;
+        }
+
+        // if we sliced further down, no need to keep source geometry
+        tile.source_features = {};
+    }
+};
+
+struct Layer {
+    std::string name;
+    feature_collection features;
+
+    // max zoom to preserve detail on
+    uint8_t maxZoom = 18;
+
+    // simplification tolerance (higher means simpler)
+    double tolerance = 3;
+};
+
+// rendered tiles of all layers at one position, by layer name
+using LayerTiles = std::map<std::string, std::shared_ptr<const Tile>>;
+
+namespace detail {
+
+struct InternalLayerTiles {
+    uint8_t z;
+    uint32_t x;
+    uint32_t y;
+
+    // one feature list and one tile per layer
+    std::vector<vt_features> source_features;
+    std::vector<InternalTile> layers;
+
+    LayerTiles tiles;
+
+    // every layer is either empty or a solid clipped square, and at least one is solid; a layer
+    // counts as empty by its source features (whose bbox is still the empty one), since features
+    // too small to render here may show up in the child tiles
+    bool isSolid() const {
+        bool solid = false;
+        for (const auto& layer : layers) {
+            if (layer.is_solid)
+                solid = true;
+            else if (layer.bbox.min.x <= layer.bbox.max.x)
+                return false;
+        }
+        return solid;
+    }
+};
+
+} // namespace detail
+
+// Tiles several named layers with a single tile tree: a request finds its parent tile and drills
+// down once for all layers. Each layer has its own maxZoom and tolerance, so options.maxZoom and
+// options.tolerance are not used. There is no getTileAsync or cancellation, so options.threads is
+// not used either, and the constructor throws for the options that only GeoJSONVT supports:
+// dedupTiles, overzoom, transientDrillDown and orderedTiles. The other options apply to all
+// layers.
+class MultiLayerGeoJSONVT {
+public:
+    const Options options;
+
+    MultiLayerGeoJSONVT(const std::vector<Layer>& layers_, const Options& options_ = Options())
+        : options(options_),
+          pool(detail::makeChunkPool(options.chunkThreads)) {
+
+        if (options.dedupTiles || options.overzoom != 0 || options.transientDrillDown ||
+            options.orderedTiles)
+            throw std::runtime_error("MultiLayerGeoJSONVT doesn't support dedupTiles, overzoom, "
+                                     "transientDrillDown or orderedTiles");
+
+        std::vector<detail::vt_features> features;
+        features.reserve(layers_.size());
+
+        for (const auto& layer : layers_) {
+            layers.push_back({ layer.name, layer.maxZoom, layer.tolerance });
+            maxZoom = std::max(maxZoom, layer.maxZoom);
+            // does not own the shared empty tile
+            empty_layers.emplace(layer.name, std::shared_ptr<const Tile>(
+                                                 std::shared_ptr<const Tile>(), &empty_tile));
+
+            const uint32_t z2 = std::pow(2, layer.maxZoom);
+            auto converted =
+                detail::convert(layer.features, (layer.tolerance / options.extent) / z2,
+                                options.simplification, pool.get(),
+                                options.segmentIndexMinPoints);
+            if (options.hilbertOrder)
+                detail::sortByHilbert(converted);
+            features.push_back(detail::wrap(std::move(converted),
+                                            double(options.buffer) / options.extent, pool.get()));
+        }
+
+        splitTile(features, 0, 0, 0);
+    }
+
+    std::map<uint8_t, uint32_t> stats;
+    uint32_t total = 0;
+
+    // layers above their maxZoom come back empty
+    const LayerTiles& getTile(const uint8_t z, const uint32_t x_, const uint32_t y) {
+
+        if (z > maxZoom)
+            throw std::runtime_error("Requested zoom higher than maxZoom: " + std::to_string(z));
+
+        const uint32_t z2 = std::pow(2, z);
+        const uint32_t x = ((x_ % z2) + z2) % z2; // wrap tile x coordinate
+        const uint64_t id = toID(z, x, y);
+
+        auto it = tiles.find(id);
+        if (it != tiles.end())
+            return it->second.tiles;
+
+        it = detail::findParent(tiles, z, x, y);
+
+        if (it == tiles.end())
+            throw std::runtime_error("Parent tile not found");
+
+        const auto& parent = it->second;
+
+        // parent tile is a solid clipped square, return it instead since it's identical
+        if (parent.isSolid())
+            return parent.tiles;
+
+        // drill down parent tile up to the requested one
+        splitTile(parent.source_features, parent.z, parent.x, parent.y, z, x, y);
+
+        it = tiles.find(id);
+        if (it != tiles.end())
+            return it->second.tiles;
+
+        it = detail::findParent(tiles, z, x, y);
+        if (it == tiles.end())
+            throw std::runtime_error("Parent tile not found");
+
+        // drilling stopped because parent was a solid square; return it instead
+        if (it->second.isSolid())
+            return it->second.tiles;
+
+        // otherwise it was an empty tile
+        return empty_layers;
+    }
+
+    const detail::TileMap<detail::InternalLayerTiles>& getInternalTiles() const {
+        return tiles;
+    }
+
+private:
+    struct LayerOptions {
+        std::string name;
+        uint8_t maxZoom;
+        double tolerance;
+    };
+
+    // threads for converting the input and clipping long feature lists, if there is more than one
+    const std::unique_ptr<detail::ThreadPool> pool;
+
+    std::vector<LayerOptions> layers;
+    uint8_t maxZoom = 0;
+    LayerTiles empty_layers;
+
+    detail::TileMap<detail::InternalLayerTiles> tiles;
+
+    double getTolerance(const size_t layer, const uint8_t z) const {
+        const double z2 = 1u << z;
+        return z >= layers[layer].maxZoom ? 0
+                                          : layers[layer].tolerance / (z2 * options.extent);
+    }
+
+    void splitTile(const std::vector<detail::vt_features>& features,
+                   const uint8_t z,
+                   const uint32_t x,
+                   const uint32_t y,
+                   const uint8_t cz = 0,
+                   const uint32_t cx = 0,
+                   const uint32_t cy = 0) {
+
+        const double z2 = 1u << z;
+        const uint64_t id = toID(z, x, y);
+
+        auto it = tiles.find(id);
+
+        if (it == tiles.end()) {
+            detail::InternalLayerTiles tile{ z, x, y, {}, {}, {} };
+            tile.layers.reserve(layers.size());
+
+            for (size_t i = 0; i < layers.size(); ++i) {
+                tile.layers.emplace_back(features[i], z, x, y, options.extent, options.buffer,
+                                         getTolerance(i, z), options.tileMaxPoints,
+                                         options.tileMaxFeatures,
+                                         z >= layers[i].maxZoom ? 0 : options.clusterRadius,
+                                         options.fixedPointMinZoom != 0 &&
+                                             z >= options.fixedPointMinZoom);
+                tile.tiles.emplace(layers[i].name, tile.layers.back().tile);
+            }
+
+            it = tiles.emplace(id, std::move(tile)).first;
+            stats[z] = (stats.count(z) ? stats[z] + 1 : 1);
+            total++;
+        }
+
+        auto& tile = it->second;
+
+        // source features are cleared to an empty list once a tile has been split
+        bool empty = true;
+        for (const auto& layer : features) {
+            empty = empty && layer.empty();
+        }
+
+        if (empty)
+            return;
+
+        uint32_t num_points = 0;
+        for (const auto& layer : tile.layers) {
+            num_points += layer.tile->num_points;
+        }
+
+        // stop tiling if the tile is solid clipped square
+        if (!options.solidChildren && tile.isSolid())
+            return;
+
+        // if it's the first-pass tiling
+        if (cz == 0u) {
+            // stop tiling if we reached max zoom, or if the tile is too simple
+            if (z == options.indexMaxZoom || num_points <= options.indexMaxPoints) {
+                tile.source_features = features;
+                return;
+            }
+
+        } else { // drilldown to a specific tile;
+            // stop tiling if we reached base zoom
+            if (z == maxZoom)
+                return;
+
+            // stop tiling if it's our target tile zoom
+            if (z == cz) {
+                tile.source_features = features;
+                return;
+            }
+
+            // stop tiling if it's not an ancestor of the target tile
+            const double m = 1u << (cz - z);
+            if (x != static_cast<uint32_t>(std::floor(cx / m)) ||
+                y != static_cast<uint32_t>(std::floor(cy / m))) {
+                tile.source_features = features;
+                return;
+            }
+        }
+
+        const double p = 0.5 * options.buffer / options.extent;
+
+        // clip every layer that still has detail below this zoom
+        const auto clip = [&](const std::vector<detail::vt_features>& source, const auto& slab) {
+            std::vector<detail::vt_features> result(layers.size());
+            for (size_t i = 0; i < layers.size(); ++i) {
+                if (z < layers[i].maxZoom)
+                    result[i] = slab(source[i], tile.layers[i].bbox, getTolerance(i, z + 1));
+            }
+            return result;
+        };
+
+        const auto clipX = [&](const double k1, const double k2) {
+            return [=](const detail::vt_features& f, const auto& bbox, const double t) {
+                return detail::clip<0>(f, k1 / z2, k2 / z2, bbox.min.x, bbox.max.x, t, nullptr,
+                                       pool.get());
+            };
+        };
+        const auto clipY = [&](const double k1, const double k2) {
+            return [=](const detail::vt_features& f, const auto& bbox, const double t) {
+                return detail::clip<1>(f, k1 / z2, k2 / z2, bbox.min.y, bbox.max.y, t, nullptr,
+                                       pool.get());
+            };
+        };
+
+        const auto left = clip(features, clipX(x - p, x + 0.5 + p));
 
-        splitTile(detail::clip<1>(left, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y), z + 1,
-                  x * 2, y * 2, cz, cx, cy);
-        splitTile(detail::clip<1>(left, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y), z + 1,
-                  x * 2, y * 2 + 1, cz, cx, cy);
+        splitTile(clip(left, clipY(y - p, y + 0.5 + p)), z + 1, x * 2, y * 2, cz, cx, cy);
+        splitTile(clip(left, clipY(y + 0.5 - p, y + 1 + p)), z + 1, x * 2, y * 2 + 1, cz, cx, cy);
 
-        const auto right =
-            detail::clip<0>(features, (x + 0.5 - p) / z2, (x + 1 + p) / z2, min.x, max.x);
+        const auto right = clip(features, clipX(x + 0.5 - p, x + 1 + p));
 
-        splitTile(detail::clip<1>(right, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y), z + 1,
-                  x * 2 + 1, y * 2, cz, cx, cy);
-        splitTile(detail::clip<1>(right, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y), z + 1,
-                  x * 2 + 1, y * 2 + 1, cz, cx, cy);
+        splitTile(clip(right, clipY(y - p, y + 0.5 + p)), z + 1, x * 2 + 1, y * 2, cz, cx, cy);
+        splitTile(clip(right, clipY(y + 0.5 - p, y + 1 + p)), z + 1, x * 2 + 1, y * 2 + 1, cz, cx,
+                  cy);
 
         // if we sliced further down, no need to keep source geometry
         tile.source_features = {};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+namespace mapbox {
+namespace geojsonvt {
+
+struct CanceledError : std::runtime_error {
+    CanceledError() : std::runtime_error("Tile request canceled") {
+    }
+};
+
+// Lets a caller give up on a tile request, either explicitly or once a deadline has passed.
+// Copies share the same state, so a token can be canceled from another thread.
+class CancellationToken {
+public:
+    using clock = std::chrono::steady_clock;
+
+    CancellationToken() : canceled(std::make_shared<std::atomic<bool>>(false)) {
+    }
+
+    explicit CancellationToken(const clock::time_point deadline_) : CancellationToken() {
+        deadline = deadline_;
+    }
+
+    void cancel() const {
+        *canceled = true;
+    }
+
+    bool isCanceled() const {
+        return *canceled || (deadline != clock::time_point::max() && clock::now() >= deadline);
+    }
+
+    void check() const {
+        if (isCanceled())
+            throw CanceledError();
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> canceled;
+    clock::time_point deadline = clock::time_point::max();
+};
+
+} // namespace geojsonvt
+} // namespace mapbox
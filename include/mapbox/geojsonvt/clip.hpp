@@ -1,18 +1,30 @@
 #pragma once
 
+#include <mapbox/geojsonvt/cancellation.hpp>
+#include <mapbox/geojsonvt/thread_pool.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 
+#include <iterator>
+#include <vector>
+
 namespace mapbox {
 namespace geojsonvt {
 namespace detail {
 
+// clips geometry between k1 and k2 along axis I, collecting the bbox and number of the points
+// it emits, so that the clipped feature doesn't need another pass over them
 template <uint8_t I>
 class clipper {
 public:
     const double k1;
     const double k2;
 
+    // accumulated over all calls
+    mutable mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
+    mutable uint32_t num_points = 0;
+
     vt_geometry operator()(const vt_point& point) const {
+        addPoint(point);
         return point;
     }
 
@@ -21,7 +33,7 @@ public:
         for (const auto& p : points) {
             const double ak = get<I>(p);
             if (ak >= k1 && ak <= k2)
-                part.push_back(p);
+                push(part, p);
         }
         return part;
     }
@@ -49,9 +61,9 @@ public:
     vt_geometry operator()(const vt_polygon& polygon) const {
         vt_polygon result;
         for (const auto& ring : polygon) {
-            const auto new_ring = clipRing(ring);
+            auto new_ring = clipRing(ring);
             if (!new_ring.empty())
-                result.push_back(new_ring);
+                result.push_back(std::move(new_ring));
         }
         return result;
     }
@@ -61,12 +73,12 @@ public:
         for (const auto& polygon : polygons) {
             vt_polygon p;
             for (const auto& ring : polygon) {
-                const auto new_ring = clipRing(ring);
+                auto new_ring = clipRing(ring);
                 if (!new_ring.empty())
-                    p.push_back(new_ring);
+                    p.push_back(std::move(new_ring));
             }
             if (!p.empty())
-                result.push_back(p);
+                result.push_back(std::move(p));
         }
         return result;
     }
@@ -81,6 +93,20 @@ public:
     }
 
 private:
+    void addPoint(const vt_point& p) const {
+        bbox.min.x = std::min(p.x, bbox.min.x);
+        bbox.min.y = std::min(p.y, bbox.min.y);
+        bbox.max.x = std::max(p.x, bbox.max.x);
+        bbox.max.y = std::max(p.y, bbox.max.y);
+        ++num_points;
+    }
+
+    template <class T>
+    void push(T& points, const vt_point& p) const {
+        addPoint(p);
+        points.push_back(p);
+    }
+
     vt_line_string newSlice(vt_multi_line_string& parts, vt_line_string& slice, double dist) const {
         if (!slice.empty()) {
             slice.dist = dist;
@@ -89,6 +115,30 @@ private:
         return {};
     }
 
+    // the bbox of the run of segments of an indexed line or ring that starts at i, if any
+    template <class T>
+    const mapbox::geometry::box<double>* runBox(const T& points, const size_t i) const {
+        if (!points.segments || i % segment_index_run != 0)
+            return nullptr;
+        return &points.segments->boxes[i / segment_index_run];
+    }
+
+    bool outside(const mapbox::geometry::box<double>& box) const {
+        return get<I>(box.max) < k1 || get<I>(box.min) > k2;
+    }
+
+    bool inside(const mapbox::geometry::box<double>& box) const {
+        return get<I>(box.min) >= k1 && get<I>(box.max) <= k2;
+    }
+
+    template <class T>
+    void pushRange(T& slice, const std::vector<vt_point>& points, size_t first, size_t last) const {
+        slice.insert(slice.end(), points.begin() + first, points.begin() + last);
+        for (size_t i = first; i < last; ++i) {
+            addPoint(points[i]);
+        }
+    }
+
     void clipLine(const vt_line_string& line, vt_multi_line_string& slices) const {
 
         const double dist = line.dist;
@@ -97,9 +147,25 @@ private:
         if (len < 2)
             return;
 
+        const size_t first = slices.size();
         vt_line_string slice;
 
         for (size_t i = 0; i < (len - 1); ++i) {
+            if (const auto* box = runBox(line, i)) {
+                if (outside(*box)) { // none of the segments of the run emit anything
+                    i += segment_index_run - 1;
+                    continue;
+                }
+                if (inside(*box)) { // each segment of the run emits its first point
+                    const size_t end = std::min(i + segment_index_run, len - 1);
+                    pushRange(slice, line, i, end);
+                    if (end == len - 1)
+                        push(slice, line[end]); // last point
+                    i = end - 1;
+                    continue;
+                }
+            }
+
             const auto& a = line[i];
             const auto& b = line[i + 1];
             const double ak = get<I>(a);
@@ -107,45 +173,51 @@ private:
 
             if (ak < k1) {
                 if (bk > k2) { // ---|-----|-->
-                    slice.push_back(intersect<I>(a, b, k1));
-                    slice.push_back(intersect<I>(a, b, k2));
+                    push(slice, intersect<I>(a, b, k1));
+                    push(slice, intersect<I>(a, b, k2));
                     slice = newSlice(slices, slice, dist);
 
                 } else if (bk >= k1) { // ---|-->  |
-                    slice.push_back(intersect<I>(a, b, k1));
+                    push(slice, intersect<I>(a, b, k1));
                     if (i == len - 2)
-                        slice.push_back(b); // last point
+                        push(slice, b); // last point
                 }
             } else if (ak > k2) {
                 if (bk < k1) { // <--|-----|---
-                    slice.push_back(intersect<I>(a, b, k2));
-                    slice.push_back(intersect<I>(a, b, k1));
+                    push(slice, intersect<I>(a, b, k2));
+                    push(slice, intersect<I>(a, b, k1));
                     slice = newSlice(slices, slice, dist);
 
                 } else if (bk <= k2) { // |  <--|---
-                    slice.push_back(intersect<I>(a, b, k2));
+                    push(slice, intersect<I>(a, b, k2));
                     if (i == len - 2)
-                        slice.push_back(b); // last point
+                        push(slice, b); // last point
                 }
             } else {
-                slice.push_back(a);
+                push(slice, a);
 
                 if (bk < k1) { // <--|---  |
-                    slice.push_back(intersect<I>(a, b, k1));
+                    push(slice, intersect<I>(a, b, k1));
                     slice = newSlice(slices, slice, dist);
 
                 } else if (bk > k2) { // |  ---|-->
-                    slice.push_back(intersect<I>(a, b, k2));
+                    push(slice, intersect<I>(a, b, k2));
                     slice = newSlice(slices, slice, dist);
 
                 } else if (i == len - 2) { // | --> |
-                    slice.push_back(b);
+                    push(slice, b);
                 }
             }
         }
 
         // add the final slice
         newSlice(slices, slice, dist);
+
+        if (line.segments) {
+            for (size_t i = first; i < slices.size(); ++i) {
+                slices[i].segments = indexSegments(slices[i], line.segments->min_points);
+            }
+        }
     }
 
     vt_linear_ring clipRing(const vt_linear_ring& ring) const {
@@ -158,6 +230,19 @@ private:
             return slice;
 
         for (size_t i = 0; i < (len - 1); ++i) {
+            if (const auto* box = runBox(ring, i)) {
+                if (outside(*box)) {
+                    i += segment_index_run - 1;
+                    continue;
+                }
+                if (inside(*box)) {
+                    const size_t end = std::min(i + segment_index_run, len - 1);
+                    pushRange(slice, ring, i, end);
+                    i = end - 1;
+                    continue;
+                }
+            }
+
             const auto& a = ring[i];
             const auto& b = ring[i + 1];
             const double ak = get<I>(a);
@@ -165,26 +250,26 @@ private:
 
             if (ak < k1) {
                 if (bk >= k1) {
-                    slice.push_back(intersect<I>(a, b, k1)); // ---|-->  |
+                    push(slice, intersect<I>(a, b, k1)); // ---|-->  |
                     if (bk > k2)                             // ---|-----|-->
-                        slice.push_back(intersect<I>(a, b, k2));
+                        push(slice, intersect<I>(a, b, k2));
                     else if (i == len - 2)
-                        slice.push_back(b); // last point
+                        push(slice, b); // last point
                 }
             } else if (ak > k2) {
                 if (bk <= k2) { // |  <--|---
-                    slice.push_back(intersect<I>(a, b, k2));
+                    push(slice, intersect<I>(a, b, k2));
                     if (bk < k1) // <--|-----|---
-                        slice.push_back(intersect<I>(a, b, k1));
+                        push(slice, intersect<I>(a, b, k1));
                     else if (i == len - 2)
-                        slice.push_back(b); // last point
+                        push(slice, b); // last point
                 }
             } else {
-                slice.push_back(a);
+                push(slice, a);
                 if (bk < k1) // <--|---  |
-                    slice.push_back(intersect<I>(a, b, k1));
+                    push(slice, intersect<I>(a, b, k1));
                 else if (bk > k2) // |  ---|-->
-                    slice.push_back(intersect<I>(a, b, k2));
+                    push(slice, intersect<I>(a, b, k2));
                 // | --> |
             }
         }
@@ -194,19 +279,72 @@ private:
             const auto& first = slice.front();
             const auto& last = slice.back();
             if (first != last) {
-                slice.push_back(first);
+                push(slice, first);
             }
         }
 
+        if (ring.segments)
+            slice.segments = indexSegments(slice, ring.segments->min_points);
+
         return slice;
     }
 };
 
+// the part of the feature between k1 and k2 along axis I
+template <uint8_t I>
+inline vt_feature clipFeature(const vt_feature& feature, const double k1, const double k2) {
+    const clipper<I> clip{ k1, k2 };
+    auto geometry = vt_geometry::visit(feature.geometry, clip);
+    return { std::move(geometry), feature.properties, clip.bbox, clip.num_points };
+}
+
+template <uint8_t I>
+inline void clipRange(const vt_features& features,
+                      const size_t begin,
+                      const size_t end,
+                      const double k1,
+                      const double k2,
+                      const double tolerance,
+                      const CancellationToken* cancel,
+                      vt_features& clipped) {
+    for (size_t i = begin; i < end; ++i) {
+        if (cancel && ((i - begin) % 64) == 0)
+            cancel->check();
+
+        const auto& feature = features[i];
+        const double min = get<I>(feature.bbox.min);
+        const double max = get<I>(feature.bbox.max);
+
+        if (min >= k1 && max <= k2) { // trivial accept
+            clipped.push_back(feature);
+
+        } else if (min > k2 || max < k1) { // trivial reject
+            continue;
+
+        } else if (!feature.isVisible(tolerance)) { // too small to show up at this zoom
+            clipped.push_back(feature);
+
+        } else {
+            clipped.push_back(clipFeature<I>(feature, k1, k2));
+        }
+    }
+}
+
+// lists of at least this many features are clipped on several threads, in chunks of this many
+// features
+constexpr size_t clip_parallel_threshold = 8192;
+constexpr size_t clip_chunk_size = 1024;
+
 /* clip features between two axis-parallel lines:
  *     |        |
  *  ___|___     |     /
  * /   |   \____|____/
  *     |        |
+ *
+ * Features that render nothing at `tolerance` are passed through unclipped; they only need to
+ * be clipped once they become visible in a deeper tile. A canceled request is checked every
+ * few features and aborts with CanceledError. Long feature lists are clipped in chunks on the
+ * calling thread and the threads of `pool`, and the chunks put back together in order.
  */
 
 template <uint8_t I>
@@ -214,7 +352,10 @@ inline vt_features clip(const vt_features& features,
                         const double k1,
                         const double k2,
                         const double minAll,
-                        const double maxAll) {
+                        const double maxAll,
+                        const double tolerance = -1,
+                        const CancellationToken* cancel = nullptr,
+                        ThreadPool* pool = nullptr) {
 
     if (minAll >= k1 && maxAll <= k2) // trivial accept
         return features;
@@ -224,24 +365,26 @@ inline vt_features clip(const vt_features& features,
 
     vt_features clipped;
 
-    for (const auto& feature : features) {
-        const auto& geom = feature.geometry;
-        const auto& props = feature.properties;
-
-        const double min = get<I>(feature.bbox.min);
-        const double max = get<I>(feature.bbox.max);
-
-        if (min >= k1 && max <= k2) { // trivial accept
-            clipped.push_back(feature);
+    if (features.size() < clip_parallel_threshold || !pool || pool->size() < 2) {
+        clipRange<I>(features, 0, features.size(), k1, k2, tolerance, cancel, clipped);
+        return clipped;
+    }
 
-        } else if (min > k2 || max < k1) { // trivial reject
-            continue;
+    std::vector<vt_features> chunks((features.size() + clip_chunk_size - 1) / clip_chunk_size);
+    parallelChunks(features.size(), clip_chunk_size, pool,
+                   [&](const size_t chunk, const size_t begin, const size_t end) {
+                       clipRange<I>(features, begin, end, k1, k2, tolerance, cancel,
+                                    chunks[chunk]);
+                   });
 
-        } else {
-            clipped.emplace_back(vt_geometry::visit(geom, clipper<I>{ k1, k2 }), props);
-        }
+    size_t size = 0;
+    for (const auto& chunk : chunks) {
+        size += chunk.size();
+    }
+    clipped.reserve(size);
+    for (auto& chunk : chunks) {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(clipped));
     }
-
     return clipped;
 }
 
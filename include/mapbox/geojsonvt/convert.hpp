@@ -1,11 +1,16 @@
 #pragma once
 
 #include <mapbox/geojsonvt/simplify.hpp>
+#include <mapbox/geojsonvt/thread_pool.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 #include <mapbox/geometry.hpp>
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
 
 namespace mapbox {
 namespace geojsonvt {
@@ -13,6 +18,10 @@ namespace detail {
 
 struct project {
     const double tolerance;
+    const Simplification simplification;
+    const size_t segmentIndexMinPoints;
+    // threads for simplifying each huge line or ring
+    const unsigned threads;
     using result_type = vt_geometry;
 
     vt_point operator()(const geometry::point<double>& p) {
@@ -44,7 +53,9 @@ struct project {
             result.dist += std::abs(b.x - a.x) + std::abs(b.y - a.y);
         }
 
-        simplify(result, tolerance);
+        simplify(result, tolerance, simplification, threads);
+        rank(result);
+        result.segments = indexSegments(result, segmentIndexMinPoints);
 
         return result;
     }
@@ -71,13 +82,16 @@ struct project {
         }
         result.area = std::abs(area / 2);
 
-        simplify(result, tolerance);
+        simplify(result, tolerance, simplification, threads);
+        rank(result);
+        result.segments = indexSegments(result, segmentIndexMinPoints);
 
         return result;
     }
 
     vt_geometry operator()(const geometry::geometry<double>& geometry) {
-        return geometry::geometry<double>::visit(geometry, project{ tolerance });
+        return geometry::geometry<double>::visit(
+            geometry, project{ tolerance, simplification, segmentIndexMinPoints, threads });
     }
 
     // Handles polygon, multi_*, geometry_collection.
@@ -92,18 +106,97 @@ struct project {
     }
 };
 
-inline vt_features convert(const geometry::feature_collection<double>& features,
-                           const double tolerance) {
+// inputs with at least this many features are converted on several threads, in chunks of
+// this many features
+constexpr size_t convert_parallel_threshold = 4096;
+constexpr size_t convert_chunk_size = 256;
+
+// project and simplify the features; the result doesn't depend on the number of threads
+inline vt_features
+convert(const geometry::feature_collection<double>& features,
+        const double tolerance,
+        const Simplification simplification = Simplification::DouglasPeucker,
+        ThreadPool* pool = nullptr,
+        const size_t segmentIndexMinPoints = 0) {
+    // huge lines and rings are only simplified on several threads when the features aren't
+    // converted on several threads already
+    const auto convertRange = [&](vt_features& projected, const size_t begin, const size_t end,
+                                  const unsigned simplifyThreads) {
+        projected.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            projected.emplace_back(
+                geometry::geometry<double>::visit(
+                    features[i].geometry,
+                    project{ tolerance, simplification, segmentIndexMinPoints, simplifyThreads }),
+                features[i].properties);
+        }
+    };
+
     vt_features projected;
+    if (features.size() < convert_parallel_threshold || !pool || pool->size() < 2) {
+        convertRange(projected, 0, features.size(), pool ? pool->size() : 1);
+        return projected;
+    }
+
+    std::vector<vt_features> chunks((features.size() + convert_chunk_size - 1) /
+                                    convert_chunk_size);
+    parallelChunks(features.size(), convert_chunk_size, pool,
+                   [&](const size_t chunk, const size_t begin, const size_t end) {
+                       convertRange(chunks[chunk], begin, end, 1);
+                   });
+
     projected.reserve(features.size());
-    for (const auto& feature : features) {
-        projected.emplace_back(
-            geometry::geometry<double>::visit(feature.geometry, project{ tolerance }),
-            feature.properties);
+    for (auto& chunk : chunks) {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(projected));
     }
     return projected;
 }
 
+// position of a point of the 2^16 x 2^16 grid along the Hilbert curve that fills it
+inline uint32_t hilbertIndex(uint32_t x, uint32_t y) {
+    uint32_t d = 0;
+    for (uint32_t s = 1u << 15; s > 0; s /= 2) {
+        const uint32_t rx = (x & s) ? 1 : 0;
+        const uint32_t ry = (y & s) ? 1 : 0;
+        d += s * s * ((3 * rx) ^ ry);
+
+        // rotate the quadrant, so that the curve inside it starts and ends at the right corners
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+// reorder features along the Hilbert curve through the centers of their bboxes, so that
+// features close to each other are also close in memory; ties keep their order
+inline void sortByHilbert(vt_features& features) {
+    const auto cell = [](const double v) {
+        return static_cast<uint32_t>(std::min(std::max(v, 0.0), 1.0) * 65535);
+    };
+
+    std::vector<std::pair<uint32_t, uint32_t>> order;
+    order.reserve(features.size());
+    for (size_t i = 0; i < features.size(); ++i) {
+        const auto& bbox = features[i].bbox;
+        order.emplace_back(hilbertIndex(cell((bbox.min.x + bbox.max.x) / 2),
+                                        cell((bbox.min.y + bbox.max.y) / 2)),
+                           static_cast<uint32_t>(i));
+    }
+    std::sort(order.begin(), order.end());
+
+    vt_features sorted;
+    sorted.reserve(features.size());
+    for (const auto& entry : order) {
+        sorted.push_back(std::move(features[entry.second]));
+    }
+    features = std::move(sorted);
+}
+
 } // namespace detail
 } // namespace geojsonvt
 } // namespace mapbox
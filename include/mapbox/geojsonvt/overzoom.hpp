@@ -0,0 +1,246 @@
+#pragma once
+
+#include <mapbox/geojsonvt/clip.hpp>
+#include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <cmath>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+// turns rendered tile geometry back into clippable features, keeping tile extent units
+struct tile_to_vt {
+    vt_geometry operator()(const mapbox::geometry::point<int16_t>& p) const {
+        return point(p);
+    }
+
+    vt_geometry operator()(const mapbox::geometry::multi_point<int16_t>& points) const {
+        vt_multi_point result;
+        result.reserve(points.size());
+        for (const auto& p : points) {
+            result.push_back(point(p));
+        }
+        return result;
+    }
+
+    vt_geometry operator()(const mapbox::geometry::line_string<int16_t>& line) const {
+        return points<vt_line_string>(line);
+    }
+
+    vt_geometry operator()(const mapbox::geometry::multi_line_string<int16_t>& lines) const {
+        vt_multi_line_string result;
+        result.reserve(lines.size());
+        for (const auto& line : lines) {
+            result.push_back(points<vt_line_string>(line));
+        }
+        return result;
+    }
+
+    vt_geometry operator()(const mapbox::geometry::polygon<int16_t>& polygon) const {
+        return rings(polygon);
+    }
+
+    vt_geometry operator()(const mapbox::geometry::multi_polygon<int16_t>& polygons) const {
+        vt_multi_polygon result;
+        result.reserve(polygons.size());
+        for (const auto& polygon : polygons) {
+            result.push_back(rings(polygon));
+        }
+        return result;
+    }
+
+    // not produced by InternalTile
+    vt_geometry operator()(const mapbox::geometry::geometry_collection<int16_t>&) const {
+        return vt_geometry_collection{};
+    }
+
+private:
+    static vt_point point(const mapbox::geometry::point<int16_t>& p) {
+        return { double(p.x), double(p.y) };
+    }
+
+    template <class T, class Points>
+    static T points(const Points& source) {
+        T result;
+        result.reserve(source.size());
+        for (const auto& p : source) {
+            result.push_back(point(p));
+        }
+        return result;
+    }
+
+    static vt_polygon rings(const mapbox::geometry::polygon<int16_t>& polygon) {
+        vt_polygon result;
+        result.reserve(polygon.size());
+        for (const auto& ring : polygon) {
+            result.push_back(points<vt_linear_ring>(ring));
+        }
+        return result;
+    }
+};
+
+// scales clipped features of a parent tile up into a descendant tile
+class OverzoomedTile {
+public:
+    Tile tile;
+
+    OverzoomedTile(const double scale_, const double ox_, const double oy_)
+        : scale(scale_), ox(ox_), oy(oy_) {
+    }
+
+    void addFeature(const vt_feature& feature) {
+        vt_geometry::visit(feature.geometry, [&](const auto& g) {
+            // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
+            this->addFeature(g, feature.properties);
+        });
+    }
+
+private:
+    const double scale;
+    const double ox;
+    const double oy;
+
+    mapbox::geometry::point<int16_t> transform(const vt_point& p) {
+        ++tile.num_points;
+        return { static_cast<int16_t>(std::round((p.x - ox) * scale)),
+                 static_cast<int16_t>(std::round((p.y - oy) * scale)) };
+    }
+
+    template <class T>
+    T transform(const std::vector<vt_point>& points) {
+        T result;
+        result.reserve(points.size());
+        for (const auto& p : points) {
+            result.push_back(transform(p));
+        }
+        return result;
+    }
+
+    mapbox::geometry::polygon<int16_t> transform(const vt_polygon& polygon) {
+        mapbox::geometry::polygon<int16_t> result;
+        for (const auto& ring : polygon) {
+            if (!ring.empty())
+                result.push_back(transform<mapbox::geometry::linear_ring<int16_t>>(ring));
+        }
+        return result;
+    }
+
+    void addFeature(const vt_point& point, const property_map& props) {
+        tile.features.push_back({ transform(point), props });
+    }
+
+    void addFeature(const vt_multi_point& points, const property_map& props) {
+        if (points.size() == 1)
+            tile.features.push_back({ transform(points.front()), props });
+        else if (!points.empty())
+            tile.features.push_back(
+                { transform<mapbox::geometry::multi_point<int16_t>>(points), props });
+    }
+
+    void addFeature(const vt_line_string& line, const property_map& props) {
+        if (!line.empty())
+            tile.features.push_back(
+                { transform<mapbox::geometry::line_string<int16_t>>(line), props });
+    }
+
+    void addFeature(const vt_multi_line_string& lines, const property_map& props) {
+        mapbox::geometry::multi_line_string<int16_t> result;
+        for (const auto& line : lines) {
+            if (!line.empty())
+                result.push_back(transform<mapbox::geometry::line_string<int16_t>>(line));
+        }
+        add(std::move(result), props);
+    }
+
+    void addFeature(const vt_polygon& polygon, const property_map& props) {
+        auto result = transform(polygon);
+        if (!result.empty())
+            tile.features.push_back({ std::move(result), props });
+    }
+
+    void addFeature(const vt_multi_polygon& polygons, const property_map& props) {
+        mapbox::geometry::multi_polygon<int16_t> result;
+        for (const auto& polygon : polygons) {
+            auto p = transform(polygon);
+            if (!p.empty())
+                result.push_back(std::move(p));
+        }
+        add(std::move(result), props);
+    }
+
+    void addFeature(const vt_geometry_collection& collection, const property_map& props) {
+        for (const auto& geom : collection) {
+            vt_geometry::visit(geom, [&](const auto& g) {
+                // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
+                this->addFeature(g, props);
+            });
+        }
+    }
+
+    template <class T>
+    void add(T&& multi, const property_map& props) {
+        switch (multi.size()) {
+        case 0:
+            break;
+        case 1:
+            tile.features.push_back({ std::move(multi[0]), props });
+            break;
+        default:
+            tile.features.push_back({ std::move(multi), props });
+            break;
+        }
+    }
+};
+
+/* render a tile dz zoom levels below a rendered tile by clipping the parent's quantized
+ * geometry to the area of the descendant tile (dx, dy relative to the parent's first
+ * descendant at that zoom) plus buffer, and scaling it up; no simplification takes place
+ */
+inline Tile overzoomTile(const Tile& parent,
+                         const uint8_t dz,
+                         const uint32_t dx,
+                         const uint32_t dy,
+                         const uint16_t extent,
+                         const uint16_t buffer,
+                         const CancellationToken* cancel = nullptr) {
+
+    const double scale = std::pow(2, dz);
+    const double size = extent / scale;
+    const double p = buffer / scale;
+    const double x0 = dx * size;
+    const double y0 = dy * size;
+
+    vt_features features;
+    features.reserve(parent.features.size());
+    mapbox::geometry::box<double> bbox = { { extent * 2.0, extent * 2.0 },
+                                           { -extent * 2.0, -extent * 2.0 } };
+
+    for (const auto& feature : parent.features) {
+        features.emplace_back(mapbox::geometry::geometry<int16_t>::visit(feature.geometry,
+                                                                         tile_to_vt{}),
+                              feature.properties);
+        const auto& b = features.back().bbox;
+        bbox.min.x = std::min(b.min.x, bbox.min.x);
+        bbox.min.y = std::min(b.min.y, bbox.min.y);
+        bbox.max.x = std::max(b.max.x, bbox.max.x);
+        bbox.max.y = std::max(b.max.y, bbox.max.y);
+    }
+
+    const auto clipped = clip<1>(clip<0>(features, x0 - p, x0 + size + p, bbox.min.x,
+                                         bbox.max.x, -1, cancel),
+                                 y0 - p, y0 + size + p, bbox.min.y, bbox.max.y, -1, cancel);
+
+    OverzoomedTile result(scale, x0, y0);
+    for (const auto& feature : clipped) {
+        result.addFeature(feature);
+    }
+    result.tile.num_simplified = result.tile.num_points;
+
+    return std::move(result.tile);
+}
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
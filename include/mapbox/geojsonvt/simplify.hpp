@@ -2,8 +2,27 @@
 
 #include <mapbox/geojsonvt/types.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
 namespace mapbox {
 namespace geojsonvt {
+
+enum class Simplification : uint8_t {
+    // keeps the points farthest from the line through their neighbours; preserves peaks
+    DouglasPeucker,
+    // drops the points forming the smallest triangles with their neighbours first; smoother
+    // shapes without spikes, and no bad cases on long jagged lines
+    VisvalingamWhyatt,
+};
+
 namespace detail {
 
 // square distance from a point to a segment
@@ -33,9 +52,15 @@ inline double getSqSegDist(const vt_point& p, const vt_point& a, const vt_point&
     return dx * dx + dy * dy;
 }
 
-// calculate simplification data using optimized Douglas-Peucker algorithm
-inline void simplify(std::vector<vt_point>& points, size_t first, size_t last, double sqTolerance) {
-    double maxSqDist = sqTolerance;
+// lines and rings with at least this many points are simplified on several threads
+constexpr size_t simplify_parallel_threshold = 1 << 20;
+
+// find the point between `first` and `last` that is farthest from the segment connecting them;
+// returns 0 if no point is farther than the tolerance
+inline size_t findSplit(const std::vector<vt_point>& points,
+                        size_t first,
+                        size_t last,
+                        double& maxSqDist) {
     size_t index = 0;
 
     for (auto i = first + 1; i < last; i++) {
@@ -47,24 +72,193 @@ inline void simplify(std::vector<vt_point>& points, size_t first, size_t last, d
         }
     }
 
-    if (maxSqDist > sqTolerance) {
-        // save the point importance in squared pixels as a z coordinate
-        points[index].z = maxSqDist;
-        if (index - first > 1)
-            simplify(points, first, index, sqTolerance);
-        if (last - index > 1)
-            simplify(points, index, last, sqTolerance);
+    return index;
+}
+
+// calculate simplification data using optimized Douglas-Peucker algorithm
+//
+// Instead of recursing, the ranges are walked left to right: every split point gets a non-zero
+// importance, which also marks it as the end of the next pending range. This needs no stack at
+// all, but expects the points between `first` and `last` to come in with z == 0.
+inline void simplify(std::vector<vt_point>& points, size_t first, size_t last, double sqTolerance) {
+    while (first < last) {
+        size_t end = first + 1;
+        while (end < last && points[end].z == 0.0)
+            end++;
+
+        double maxSqDist = sqTolerance;
+        const size_t index = findSplit(points, first, end, maxSqDist);
+
+        if (maxSqDist > sqTolerance) {
+            // save the point importance in squared pixels as a z coordinate
+            points[index].z = maxSqDist;
+        } else {
+            first = end;
+        }
+    }
+}
+
+// split the top levels breadth-first until there are enough independent ranges, then finish
+// them on separate threads; the resulting importance values are the same as in the serial case
+inline void simplifyParallel(std::vector<vt_point>& points, double sqTolerance, unsigned threads) {
+    std::vector<std::pair<size_t, size_t>> ranges{ { 0, points.size() - 1 } };
+    std::vector<std::pair<size_t, size_t>> pending;
+
+    while (!ranges.empty() && pending.size() + ranges.size() < threads * 4) {
+        std::vector<std::pair<size_t, size_t>> next;
+        for (const auto& range : ranges) {
+            double maxSqDist = sqTolerance;
+            const size_t index = findSplit(points, range.first, range.second, maxSqDist);
+
+            if (maxSqDist > sqTolerance) {
+                points[index].z = maxSqDist;
+                next.emplace_back(range.first, index);
+                next.emplace_back(index, range.second);
+            }
+        }
+        ranges = std::move(next);
+
+        // keep splitting only the ranges that are still large enough to be worth it
+        const auto small = std::partition(ranges.begin(), ranges.end(), [](const auto& range) {
+            return range.second - range.first >= simplify_parallel_threshold / 16;
+        });
+        pending.insert(pending.end(), small, ranges.end());
+        ranges.erase(small, ranges.end());
+    }
+    pending.insert(pending.end(), ranges.begin(), ranges.end());
+
+    // largest ranges first, so that the threads finish at about the same time
+    std::sort(pending.begin(), pending.end(), [](const auto& a, const auto& b) {
+        return a.second - a.first > b.second - b.first;
+    });
+
+    std::atomic<size_t> next{ 0 };
+    const auto worker = [&] {
+        for (size_t i = next++; i < pending.size(); i = next++) {
+            simplify(points, pending[i].first, pending[i].second, sqTolerance);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
     }
 }
 
-inline void simplify(std::vector<vt_point>& points, double tolerance) {
+// area of the triangle formed by three points
+inline double getTriangleArea(const vt_point& a, const vt_point& b, const vt_point& c) {
+    return std::abs((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y)) / 2;
+}
+
+// calculate simplification data using the Visvalingam-Whyatt algorithm
+//
+// Points are removed one by one in order of the area of the triangle they form with their
+// remaining neighbours, kept in a heap with stale entries skipped. The importance of a point is
+// the largest area removed up to and including it, so that a tolerance keeps exactly the points
+// that the algorithm would keep when stopped there. Points below the tolerance get none.
+inline void simplifyVisvalingam(std::vector<vt_point>& points, double sqTolerance) {
+    const auto len = static_cast<uint32_t>(points.size());
+    if (len < 3)
+        return;
+
+    std::vector<uint32_t> prev(len);
+    std::vector<uint32_t> next(len);
+    std::vector<double> areas(len, 0.0);
+
+    using entry = std::pair<double, uint32_t>;
+    std::vector<entry> heap;
+    heap.reserve(len);
+
+    for (uint32_t i = 1; i < len - 1; ++i) {
+        prev[i] = i - 1;
+        next[i] = i + 1;
+        areas[i] = getTriangleArea(points[i - 1], points[i], points[i + 1]);
+        heap.emplace_back(areas[i], i);
+    }
+    std::make_heap(heap.begin(), heap.end(), std::greater<entry>());
+
+    const auto update = [&](const uint32_t i) {
+        if (i == 0 || i == len - 1)
+            return;
+        areas[i] = getTriangleArea(points[prev[i]], points[i], points[next[i]]);
+        heap.emplace_back(areas[i], i);
+        std::push_heap(heap.begin(), heap.end(), std::greater<entry>());
+    };
+
+    double maxArea = 0.0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<entry>());
+        const entry top = heap.back();
+        heap.pop_back();
+
+        const uint32_t i = top.second;
+        if (top.first != areas[i] || points[i].z != 0.0)
+            continue; // removed already, or its area changed since
+
+        maxArea = std::max(maxArea, top.first);
+        points[i].z = maxArea > sqTolerance ? maxArea : -1.0;
+
+        next[prev[i]] = next[i];
+        prev[next[i]] = prev[i];
+        update(prev[i]);
+        update(next[i]);
+    }
+
+    for (auto& p : points) {
+        p.z = std::max(p.z, 0.0);
+    }
+}
+
+inline void simplify(std::vector<vt_point>& points, double tolerance, unsigned threads = 1) {
     const size_t len = points.size();
 
     // always retain the endpoints (1 is the max value)
     points[0].z = 1.0;
     points[len - 1].z = 1.0;
 
-    simplify(points, 0, len - 1, tolerance * tolerance);
+    if (len >= simplify_parallel_threshold && threads > 1)
+        simplifyParallel(points, tolerance * tolerance, threads);
+    else
+        simplify(points, 0, len - 1, tolerance * tolerance);
+}
+
+inline void simplify(std::vector<vt_point>& points,
+                     double tolerance,
+                     Simplification algorithm,
+                     unsigned threads = 1) {
+    if (algorithm == Simplification::DouglasPeucker) {
+        simplify(points, tolerance, threads);
+        return;
+    }
+
+    points.front().z = 1.0;
+    points.back().z = 1.0;
+    simplifyVisvalingam(points, tolerance * tolerance);
+}
+
+// lines and rings with at least this many points get a ranking of their simplified points
+constexpr size_t rank_threshold = 256;
+
+// rank the points of a simplified line or ring by importance; points with the same importance
+// stay in order
+template <class T>
+inline void rank(T& points) {
+    if (points.size() < rank_threshold)
+        return;
+
+    auto ranking = std::make_shared<std::vector<uint32_t>>();
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (points[i].z > 0.0)
+            ranking->push_back(static_cast<uint32_t>(i));
+    }
+    std::stable_sort(ranking->begin(), ranking->end(), [&](const uint32_t a, const uint32_t b) {
+        return points[a].z > points[b].z;
+    });
+    points.ranking = std::move(ranking);
 }
 
 } // namespace detail
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <condition_variable>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+// fixed-size pool of worker threads running tasks in the order they were scheduled
+class ThreadPool {
+public:
+    explicit ThreadPool(const unsigned threads) {
+        for (unsigned i = 0; i < std::max(threads, 1u); ++i) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // finishes the tasks that are already queued before returning
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    unsigned size() const {
+        return static_cast<unsigned>(workers.size());
+    }
+
+    void schedule(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push(std::move(task));
+        }
+        condition.notify_one();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+/* call f(chunk, begin, end) for consecutive chunks of [0, count) on the calling thread and the
+ * threads of the pool, if there is one; chunks are handed out in order as threads become free,
+ * so that a few expensive items don't hold up the rest. The calling thread only waits for the
+ * pool threads that have started on the chunks, so this can be called from a task on the same
+ * pool even when all of its threads are busy. The first exception thrown by f is rethrown once
+ * all threads are done.
+ */
+template <class F>
+void parallelChunks(const std::size_t count, const std::size_t chunk, ThreadPool* pool, F f) {
+    struct State {
+        std::atomic<std::size_t> next{ 0 };
+        std::mutex mutex;
+        std::condition_variable idle;
+        unsigned active = 0;
+        bool finished = false;
+        std::exception_ptr error;
+    };
+
+    const std::size_t chunks = (count + chunk - 1) / chunk;
+    const auto state = std::make_shared<State>();
+
+    // f is only called while the calling thread waits for it
+    const auto work = [state, &f, count, chunk, chunks] {
+        try {
+            for (std::size_t i = state->next++; i < chunks; i = state->next++) {
+                f(i, i * chunk, std::min(count, (i + 1) * chunk));
+            }
+        } catch (...) {
+            state->next = chunks;
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!state->error)
+                state->error = std::current_exception();
+        }
+    };
+
+    const std::size_t helpers =
+        pool && chunks > 1 ? std::min<std::size_t>(pool->size(), chunks - 1) : 0;
+    for (std::size_t i = 0; i < helpers; ++i) {
+        pool->schedule([state, work] {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->finished)
+                    return;
+                state->active++;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->active--;
+            state->idle.notify_one();
+        });
+    }
+
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished = true;
+    state->idle.wait(lock, [&] { return state->active == 0; });
+
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
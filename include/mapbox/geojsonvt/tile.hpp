@@ -2,6 +2,12 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <mapbox/geojsonvt/types.hpp>
 
 namespace mapbox {
@@ -25,7 +31,8 @@ public:
     bool is_solid = false;
     mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
 
-    Tile tile;
+    // shared between tiles with identical content when deduplication is enabled
+    std::shared_ptr<Tile> tile = std::make_shared<Tile>();
 
     InternalTile(const vt_features& source,
                  const uint8_t z_,
@@ -33,46 +40,167 @@ public:
                  const uint32_t y_,
                  const uint16_t extent_,
                  const uint16_t buffer,
-                 const double tolerance_)
+                 const double tolerance_,
+                 const uint32_t max_points = 0,
+                 const uint32_t max_features = 0,
+                 const uint16_t cluster_radius_ = 0,
+                 const bool fixed_point_ = false)
         : z(z_),
           x(x_),
           y(y_),
           z2(std::pow(2, z)),
           extent(extent_),
           tolerance(tolerance_),
-          sq_tolerance(tolerance_ * tolerance_) {
+          sq_tolerance(tolerance_ * tolerance_),
+          cluster_radius(cluster_radius_),
+          fixed_point(fixed_point_),
+          world_scale(z2 * extent),
+          world_offset(2 * world_scale + 0.5),
+          origin_x(2 * static_cast<int64_t>(world_scale) + int64_t(x) * extent),
+          origin_y(2 * static_cast<int64_t>(world_scale) + int64_t(y) * extent) {
 
         for (const auto& feature : source) {
-            const auto& geom = feature.geometry;
-            const auto& props = feature.properties;
-
-            tile.num_points += feature.num_points;
-
-            vt_geometry::visit(geom, [&](const auto& g) {
-                // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
-                this->addFeature(g, props);
-            });
+            tile->num_points += feature.num_points;
 
             bbox.min.x = std::min(feature.bbox.min.x, bbox.min.x);
             bbox.min.y = std::min(feature.bbox.min.y, bbox.min.y);
             bbox.max.x = std::max(feature.bbox.max.x, bbox.max.x);
             bbox.max.y = std::max(feature.bbox.max.y, bbox.max.y);
+
+            addFeature(feature);
         }
+        addClusters();
+
+        if (!fits(max_points, max_features))
+            fitBudget(source, max_points, max_features);
 
         is_solid = isSolid(buffer);
     }
 
 private:
+    // how many times the tolerance is doubled before features get dropped from a tile that
+    // exceeds its budget
+    static constexpr uint8_t budget_tolerance_steps = 4;
+
     const double z2;
     const uint16_t extent;
-    const double tolerance;
-    const double sq_tolerance;
+    double tolerance;
+    double sq_tolerance;
+
+    // points that fall into the same grid cell of this size are merged (0 means no clustering)
+    const uint16_t cluster_radius;
+
+    // Whether points are transformed in fixed point: a point is scaled to world coordinates in
+    // tile units, shifted by two worlds so that truncating it rounds it, and converted to an
+    // integer once, then the tile origin is subtracted in integer math. This skips the
+    // std::round call of the floating point path and matches it within one unit (ties round up
+    // instead of away from zero).
+    const bool fixed_point;
+    const double world_scale;
+    const double world_offset;
+    const int64_t origin_x;
+    const int64_t origin_y;
+
+    struct cluster {
+        mapbox::geometry::point<int16_t> point;
+        const property_map* props;
+        int64_t sum_x = 0;
+        int64_t sum_y = 0;
+        uint64_t count = 0;
+        property_map aggregated;
+    };
+
+    std::unordered_map<uint64_t, size_t> cluster_cells;
+    std::vector<cluster> clusters;
+
+    bool fits(const uint32_t max_points, const uint32_t max_features) const {
+        return (max_points == 0 || tile->num_simplified <= max_points) &&
+               (max_features == 0 || tile->features.size() <= max_features);
+    }
+
+    // raise the tolerance step by step, then drop the least significant features (shortest
+    // lines and smallest rings first) until the tile fits into the budget
+    void
+    fitBudget(const vt_features& source, const uint32_t max_points, const uint32_t max_features) {
+        for (uint8_t i = 0; i < budget_tolerance_steps && !fits(max_points, max_features); ++i) {
+            tolerance = tolerance > 0 ? tolerance * 2 : 1.0 / (z2 * extent);
+            sq_tolerance = tolerance * tolerance;
+
+            tile->features.clear();
+            tile->num_simplified = 0;
+            for (const auto& feature : source) {
+                addFeature(feature);
+            }
+            addClusters();
+        }
+
+        if (fits(max_points, max_features))
+            return;
+
+        // render the features one by one to find out what each of them costs; every cluster
+        // counts as a separate point feature
+        struct unit {
+            double significance;
+            size_t first;
+            size_t last;
+            uint32_t points;
+        };
+        std::vector<unit> units;
+        units.reserve(source.size());
+
+        tile->features.clear();
+        tile->num_simplified = 0;
+        for (const auto& feature : source) {
+            const size_t first = tile->features.size();
+            const uint32_t num_simplified = tile->num_simplified;
+            addFeature(feature);
+            units.push_back({ std::max(feature.size.dist, std::sqrt(feature.size.area)), first,
+                              tile->features.size(), tile->num_simplified - num_simplified });
+        }
+        const size_t first_cluster = tile->features.size();
+        addClusters();
+        for (size_t i = first_cluster; i < tile->features.size(); ++i) {
+            units.push_back({ 0.0, i, i + 1, 1 });
+        }
+
+        std::vector<size_t> order(units.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+            return units[a].significance > units[b].significance;
+        });
+
+        std::vector<bool> keep(units.size(), false);
+        uint32_t num_points = 0;
+        size_t num_features = 0;
+        for (const auto i : order) {
+            const size_t count = units[i].last - units[i].first;
+            if ((max_points != 0 && num_points + units[i].points > max_points) ||
+                (max_features != 0 && num_features + count > max_features))
+                break;
+            keep[i] = true;
+            num_points += units[i].points;
+            num_features += count;
+        }
+
+        mapbox::geometry::feature_collection<int16_t> kept;
+        kept.reserve(num_features);
+        for (size_t i = 0; i < units.size(); ++i) {
+            if (!keep[i])
+                continue;
+            for (size_t j = units[i].first; j < units[i].last; ++j) {
+                kept.push_back(std::move(tile->features[j]));
+            }
+        }
+
+        tile->features = std::move(kept);
+        tile->num_simplified = num_points;
+    }
 
     bool isSolid(const uint16_t buffer) {
-        if (tile.features.size() != 1)
+        if (tile->features.size() != 1)
             return false;
 
-        const auto& geom = tile.features.front().geometry;
+        const auto& geom = tile->features.front().geometry;
         if (!geom.is<mapbox::geometry::polygon<int16_t>>())
             return false;
 
@@ -94,20 +222,43 @@ private:
         return true;
     }
 
+    void addFeature(const vt_feature& feature) {
+        if (!feature.isVisible(tolerance))
+            return;
+
+        vt_geometry::visit(feature.geometry, [&](const auto& g) {
+            // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
+            this->addFeature(g, feature.properties);
+        });
+    }
+
     void addFeature(const vt_point& point, const property_map& props) {
-        tile.features.push_back({ transform(point), props });
+        if (cluster_radius != 0)
+            addToCluster(transform(point), props);
+        else
+            tile->features.push_back({ transform(point), props });
+    }
+
+    void addFeature(const vt_multi_point& points, const property_map& props) {
+        if (cluster_radius == 0) {
+            addFeature<vt_multi_point>(points, props);
+            return;
+        }
+        for (const auto& p : points) {
+            addToCluster(transform(p), props);
+        }
     }
 
     void addFeature(const vt_line_string& line, const property_map& props) {
-        const auto new_line = transform(line);
+        auto new_line = transform(line);
         if (!new_line.empty())
-            tile.features.push_back({ std::move(new_line), props });
+            tile->features.push_back({ std::move(new_line), props });
     }
 
     void addFeature(const vt_polygon& polygon, const property_map& props) {
-        const auto new_polygon = transform(polygon);
+        auto new_polygon = transform(polygon);
         if (!new_polygon.empty())
-            tile.features.push_back({ std::move(new_polygon), props });
+            tile->features.push_back({ std::move(new_polygon), props });
     }
 
     void addFeature(const vt_geometry_collection& collection, const property_map& props) {
@@ -121,22 +272,104 @@ private:
 
     template <class T>
     void addFeature(const T& multi, const property_map& props) {
-        const auto new_multi = transform(multi);
+        auto new_multi = transform(multi);
 
         switch (new_multi.size()) {
         case 0:
             break;
         case 1:
-            tile.features.push_back({ std::move(new_multi[0]), props });
+            tile->features.push_back({ std::move(new_multi[0]), props });
             break;
         default:
-            tile.features.push_back({ std::move(new_multi), props });
+            tile->features.push_back({ std::move(new_multi), props });
             break;
         }
     }
 
+    void addToCluster(const mapbox::geometry::point<int16_t>& p, const property_map& props) {
+        const auto cx = static_cast<int32_t>(std::floor(double(p.x) / cluster_radius));
+        const auto cy = static_cast<int32_t>(std::floor(double(p.y) / cluster_radius));
+        const uint64_t cell =
+            (uint64_t(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+
+        const auto it = cluster_cells.emplace(cell, clusters.size()).first;
+        if (it->second == clusters.size())
+            clusters.push_back({ p, &props, 0, 0, 0, {} });
+
+        auto& c = clusters[it->second];
+        c.sum_x += p.x;
+        c.sum_y += p.y;
+        c.count++;
+        aggregate(c.aggregated, props);
+    }
+
+    // sum up numeric properties of clustered points; other properties are left out
+    static void aggregate(property_map& sums, const property_map& props) {
+        for (const auto& pair : props) {
+            const auto& value = pair.second;
+            if (!value.is<uint64_t>() && !value.is<int64_t>() && !value.is<double>())
+                continue;
+
+            auto it = sums.find(pair.first);
+            if (it == sums.end()) {
+                sums.emplace(pair);
+                continue;
+            }
+
+            auto& sum = it->second;
+            if (sum.is<uint64_t>() && value.is<uint64_t>()) {
+                sum = mapbox::geometry::value(sum.get<uint64_t>() + value.get<uint64_t>());
+            } else if (sum.is<int64_t>() && value.is<int64_t>()) {
+                sum = mapbox::geometry::value(sum.get<int64_t>() + value.get<int64_t>());
+            } else {
+                sum = mapbox::geometry::value(toDouble(sum) + toDouble(value));
+            }
+        }
+    }
+
+    static double toDouble(const mapbox::geometry::value& value) {
+        if (value.is<uint64_t>())
+            return double(value.get<uint64_t>());
+        if (value.is<int64_t>())
+            return double(value.get<int64_t>());
+        return value.get<double>();
+    }
+
+    // single points in a cell keep their properties; everything else becomes one point at the
+    // center of its members, with `point_count` and the summed numeric properties
+    void addClusters() {
+        for (auto& c : clusters) {
+            if (c.count == 1) {
+                tile->features.push_back({ c.point, *c.props });
+                continue;
+            }
+
+            tile->num_simplified -= c.count - 1;
+
+            auto& props = c.aggregated;
+            props["cluster"] = true;
+            props["point_count"] = c.count;
+
+            const double count = c.count;
+            tile->features.push_back(
+                { mapbox::geometry::point<int16_t>(
+                      static_cast<int16_t>(std::round(c.sum_x / count)),
+                      static_cast<int16_t>(std::round(c.sum_y / count))),
+                  std::move(props) });
+        }
+
+        clusters = {};
+        cluster_cells = {};
+    }
+
     mapbox::geometry::point<int16_t> transform(const vt_point& p) {
-        ++tile.num_simplified;
+        ++tile->num_simplified;
+        if (fixed_point) {
+            return { static_cast<int16_t>(
+                         static_cast<int64_t>(p.x * world_scale + world_offset) - origin_x),
+                     static_cast<int16_t>(
+                         static_cast<int64_t>(p.y * world_scale + world_offset) - origin_y) };
+        }
         return { static_cast<int16_t>(std::round((p.x * z2 - x) * extent)),
                  static_cast<int16_t>(std::round((p.y * z2 - y) * extent)) };
     }
@@ -150,26 +383,47 @@ private:
         return result;
     }
 
-    mapbox::geometry::line_string<int16_t> transform(const vt_line_string& line) {
-        mapbox::geometry::line_string<int16_t> result;
-        if (line.dist > tolerance) {
-            for (const auto& p : line) {
-                if (p.z > sq_tolerance)
-                    result.push_back(transform(p));
+    // the points that survive simplification, in order; when only a few of the points of a
+    // ranked line or ring survive, they are looked up in its ranking instead of checking them all
+    template <class T, class Points>
+    T transformPoints(const Points& points) {
+        T result;
+
+        if (points.ranking) {
+            const auto& ranking = *points.ranking;
+            const auto end = std::partition_point(
+                ranking.begin(), ranking.end(),
+                [&](const uint32_t i) { return points[i].z > sq_tolerance; });
+
+            const auto count = static_cast<size_t>(end - ranking.begin());
+            if (count * 8 < points.size()) {
+                std::vector<uint32_t> kept(ranking.begin(), end);
+                std::sort(kept.begin(), kept.end());
+                result.reserve(count);
+                for (const uint32_t i : kept) {
+                    result.push_back(transform(points[i]));
+                }
+                return result;
             }
         }
+
+        for (const auto& p : points) {
+            if (p.z > sq_tolerance)
+                result.push_back(transform(p));
+        }
         return result;
     }
 
+    mapbox::geometry::line_string<int16_t> transform(const vt_line_string& line) {
+        if (line.dist > tolerance)
+            return transformPoints<mapbox::geometry::line_string<int16_t>>(line);
+        return {};
+    }
+
     mapbox::geometry::linear_ring<int16_t> transform(const vt_linear_ring& ring) {
-        mapbox::geometry::linear_ring<int16_t> result;
-        if (ring.area > sq_tolerance) {
-            for (const auto& p : ring) {
-                if (p.z > sq_tolerance)
-                    result.push_back(transform(p));
-            }
-        }
-        return result;
+        if (ring.area > sq_tolerance)
+            return transformPoints<mapbox::geometry::linear_ring<int16_t>>(ring);
+        return {};
     }
 
     mapbox::geometry::multi_line_string<int16_t> transform(const vt_multi_line_string& lines) {
@@ -193,7 +447,7 @@ private:
     mapbox::geometry::multi_polygon<int16_t> transform(const vt_multi_polygon& polygons) {
         mapbox::geometry::multi_polygon<int16_t> result;
         for (const auto& polygon : polygons) {
-            const auto p = transform(polygon);
+            auto p = transform(polygon);
             if (!p.empty())
                 result.push_back(std::move(p));
         }
@@ -201,6 +455,98 @@ private:
     }
 };
 
+struct value_hash {
+    std::size_t operator()(const bool value) const {
+        return std::hash<bool>()(value);
+    }
+
+    std::size_t operator()(const uint64_t value) const {
+        return std::hash<uint64_t>()(value);
+    }
+
+    std::size_t operator()(const int64_t value) const {
+        return std::hash<int64_t>()(value);
+    }
+
+    std::size_t operator()(const double value) const {
+        return std::hash<double>()(value);
+    }
+
+    std::size_t operator()(const std::string& value) const {
+        return std::hash<std::string>()(value);
+    }
+
+    std::size_t operator()(const mapbox::geometry::value& value) const {
+        return mapbox::geometry::value::visit(value, *this);
+    }
+
+    template <class T>
+    std::size_t operator()(const std::vector<T>& values) const {
+        std::size_t seed = values.size();
+        for (const auto& value : values) {
+            seed = combine(seed, (*this)(value));
+        }
+        return seed;
+    }
+
+    // independent of the iteration order, which may differ between equal maps
+    template <class K, class V>
+    std::size_t operator()(const std::unordered_map<K, V>& values) const {
+        std::size_t seed = values.size();
+        for (const auto& pair : values) {
+            seed += combine(std::hash<K>()(pair.first), (*this)(pair.second));
+        }
+        return seed;
+    }
+
+    // null value
+    template <class T>
+    std::size_t operator()(const T&) const {
+        return 0;
+    }
+
+    static std::size_t combine(const std::size_t seed, const std::size_t value) {
+        return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    }
+};
+
+// hash of the tile content, for finding identical tiles
+inline std::size_t hashTile(const Tile& tile) {
+    std::size_t seed = value_hash::combine(tile.num_points, tile.num_simplified);
+    for (const auto& feature : tile.features) {
+        seed = value_hash::combine(seed, feature.geometry.which());
+        mapbox::geometry::for_each_point(
+            feature.geometry, [&](const mapbox::geometry::point<int16_t>& p) {
+                seed = value_hash::combine(seed, (uint32_t(uint16_t(p.x)) << 16) | uint16_t(p.y));
+            });
+        seed = value_hash::combine(seed, value_hash()(feature.properties));
+    }
+    return seed;
+}
+
+inline bool equalTiles(const Tile& a, const Tile& b) {
+    return a.num_points == b.num_points && a.num_simplified == b.num_simplified &&
+           std::equal(a.features.begin(), a.features.end(), b.features.begin(), b.features.end(),
+                      [](const auto& fa, const auto& fb) {
+                          return fa.geometry == fb.geometry && fa.properties == fb.properties;
+                      });
+}
+
+// rough number of bytes held by a tile
+inline std::size_t tileBytes(const Tile& tile) {
+    std::size_t bytes = sizeof(Tile) + tile.features.capacity() * sizeof(tile.features.front());
+    for (const auto& feature : tile.features) {
+        mapbox::geometry::for_each_point(feature.geometry,
+                                         [&](const mapbox::geometry::point<int16_t>& p) {
+                                             bytes += sizeof(p);
+                                         });
+        for (const auto& pair : feature.properties) {
+            bytes += sizeof(pair) + pair.first.capacity();
+        }
+    }
+    return bytes;
+}
+
 } // namespace detail
 } // namespace geojsonvt
 } // namespace mapbox
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* map from tile ids to tiles, with the subset of the std::unordered_map interface that the
+ * index uses
+ *
+ * Lookups go through a flat open-addressing table of (id, entry index) slots with linear
+ * probing, so that a miss or a hit touches one or two cache lines instead of a bucket list.
+ * The entries themselves live in a slab of deque chunks that never moves, so references to
+ * them stay valid while other tiles are inserted or erased (iterators don't). Erased entries
+ * are reused by later inserts; iteration follows slab order.
+ */
+template <class T>
+class TileMap {
+public:
+    using value_type = std::pair<const uint64_t, T>;
+
+    template <class Map, class Value>
+    class basic_iterator {
+    public:
+        Value& operator*() const {
+            return map->entries[i].value();
+        }
+        Value* operator->() const {
+            return &map->entries[i].value();
+        }
+
+        basic_iterator& operator++() {
+            ++i;
+            skip();
+            return *this;
+        }
+
+        bool operator==(const basic_iterator& other) const {
+            return i == other.i;
+        }
+        bool operator!=(const basic_iterator& other) const {
+            return i != other.i;
+        }
+
+    private:
+        friend class TileMap;
+
+        Map* map;
+        std::size_t i;
+
+        basic_iterator(Map* map_, const std::size_t i_) : map(map_), i(i_) {
+            skip();
+        }
+
+        void skip() {
+            while (i < map->entries.size() && !map->entries[i].alive) {
+                ++i;
+            }
+        }
+    };
+
+    using iterator = basic_iterator<TileMap, value_type>;
+    using const_iterator = basic_iterator<const TileMap, const value_type>;
+
+    TileMap() = default;
+    TileMap(const TileMap&) = delete;
+    TileMap& operator=(const TileMap&) = delete;
+
+    ~TileMap() {
+        for (auto& e : entries) {
+            if (e.alive)
+                e.value().~value_type();
+        }
+    }
+
+    iterator begin() {
+        return { this, 0 };
+    }
+    iterator end() {
+        return { this, entries.size() };
+    }
+    const_iterator begin() const {
+        return { this, 0 };
+    }
+    const_iterator end() const {
+        return { this, entries.size() };
+    }
+
+    std::size_t size() const {
+        return entries.size() - unused.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    iterator find(const uint64_t id) {
+        const std::size_t i = findSlot(id);
+        return { this, i == npos ? entries.size() : slots[i].entry };
+    }
+
+    const_iterator find(const uint64_t id) const {
+        const std::size_t i = findSlot(id);
+        return { this, i == npos ? entries.size() : slots[i].entry };
+    }
+
+    std::size_t count(const uint64_t id) const {
+        return findSlot(id) == npos ? 0 : 1;
+    }
+
+    std::pair<iterator, bool> emplace(const uint64_t id, T&& value) {
+        if ((size() + 1) * 4 > slots.size() * 3)
+            grow();
+
+        std::size_t i = hash(id);
+        while (slots[i].id != empty_id) {
+            if (slots[i].id == id)
+                return { { this, slots[i].entry }, false };
+            i = (i + 1) & mask;
+        }
+
+        std::size_t index = entries.size();
+        if (unused.empty()) {
+            entries.emplace_back();
+        } else {
+            index = unused.back();
+            unused.pop_back();
+        }
+
+        auto& e = entries[index];
+        new (&e.storage) value_type(id, std::move(value));
+        e.alive = true;
+        slots[i] = { id, index };
+
+        return { { this, index }, true };
+    }
+
+    std::size_t erase(const uint64_t id) {
+        std::size_t i = findSlot(id);
+        if (i == npos)
+            return 0;
+
+        auto& e = entries[slots[i].entry];
+        e.value().~value_type();
+        e.alive = false;
+        unused.push_back(slots[i].entry);
+
+        // shift the following slots of the probe sequence back instead of leaving a tombstone;
+        // a slot moves into the hole unless its home slot lies cyclically in (hole, slot]
+        std::size_t j = i;
+        while (true) {
+            j = (j + 1) & mask;
+            if (slots[j].id == empty_id)
+                break;
+            const std::size_t k = hash(slots[j].id);
+            if (j > i ? (k <= i || k > j) : (k <= i && k > j)) {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i].id = empty_id;
+
+        return 1;
+    }
+
+private:
+    // the largest tile id is toID(31, ...) with all bits set, far beyond any valid zoom
+    static constexpr uint64_t empty_id = std::numeric_limits<uint64_t>::max();
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    struct slot {
+        uint64_t id;
+        std::size_t entry;
+    };
+
+    struct entry {
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+        bool alive = false;
+
+        value_type& value() {
+            return *reinterpret_cast<value_type*>(&storage);
+        }
+        const value_type& value() const {
+            return *reinterpret_cast<const value_type*>(&storage);
+        }
+    };
+
+    std::vector<slot> slots;
+    std::deque<entry> entries;
+    std::vector<std::size_t> unused;
+    std::size_t mask = 0;
+    uint8_t bits = 0;
+
+    // Fibonacci hashing spreads the structured ids (zoom in the low bits, then x and y) evenly
+    std::size_t hash(const uint64_t id) const {
+        return static_cast<std::size_t>((id * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+    }
+
+    std::size_t findSlot(const uint64_t id) const {
+        if (slots.empty())
+            return npos;
+
+        std::size_t i = hash(id);
+        while (slots[i].id != empty_id) {
+            if (slots[i].id == id)
+                return i;
+            i = (i + 1) & mask;
+        }
+        return npos;
+    }
+
+    void grow() {
+        bits = slots.empty() ? 4 : bits + 1;
+        slots.assign(std::size_t(1) << bits, slot{ empty_id, 0 });
+        mask = slots.size() - 1;
+
+        for (std::size_t index = 0; index < entries.size(); ++index) {
+            if (!entries[index].alive)
+                continue;
+            const uint64_t id = entries[index].value().first;
+            std::size_t i = hash(id);
+            while (slots[i].id != empty_id) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = { id, index };
+        }
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -4,6 +4,9 @@
 #include <mapbox/variant.hpp>
 
 #include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
 #include <vector>
 
 namespace mapbox {
@@ -56,16 +59,62 @@ inline vt_point intersect<1>(const vt_point& a, const vt_point& b, const double
 
 using vt_multi_point = std::vector<vt_point>;
 
+// positions of the simplified points of a line or ring sorted by decreasing importance, so that
+// the points kept at any tolerance are a prefix of it; shared by unchanged copies of the points
+using vt_ranking = std::shared_ptr<const std::vector<uint32_t>>;
+
+// number of segments of a line or ring covered by each box of a segment index
+constexpr size_t segment_index_run = 64;
+
+// bboxes of consecutive runs of segments of a huge line or ring, so that clipping can skip the
+// runs that lie entirely outside; shared by unchanged copies of the points
+struct vt_segment_index {
+    // clipped parts of the line or ring with at least this many points get an index as well
+    size_t min_points;
+    std::vector<mapbox::geometry::box<double>> boxes;
+};
+
+using vt_segment_index_ptr = std::shared_ptr<const vt_segment_index>;
+
+// index the segments of the points if there are at least min_points of them (0 means never)
+inline vt_segment_index_ptr indexSegments(const std::vector<vt_point>& points,
+                                          const size_t min_points) {
+    if (min_points == 0 || points.size() < std::max<size_t>(min_points, 2))
+        return {};
+
+    auto index = std::make_shared<vt_segment_index>();
+    index->min_points = min_points;
+    index->boxes.reserve((points.size() - 2) / segment_index_run + 1);
+
+    // each box covers the points of its segments, including the first point of the next run
+    for (size_t first = 0; first < points.size() - 1; first += segment_index_run) {
+        const size_t last = std::min(first + segment_index_run, points.size() - 1);
+        mapbox::geometry::box<double> box = { points[first], points[first] };
+        for (size_t i = first + 1; i <= last; ++i) {
+            box.min.x = std::min(points[i].x, box.min.x);
+            box.min.y = std::min(points[i].y, box.min.y);
+            box.max.x = std::max(points[i].x, box.max.x);
+            box.max.y = std::max(points[i].y, box.max.y);
+        }
+        index->boxes.push_back(box);
+    }
+    return index;
+}
+
 struct vt_line_string : std::vector<vt_point> {
     using container_type = std::vector<vt_point>;
     using container_type::container_type;
     double dist = 0.0; // line length
+    vt_ranking ranking; // only set for large lines
+    vt_segment_index_ptr segments; // only set for huge lines
 };
 
 struct vt_linear_ring : std::vector<vt_point> {
     using container_type = std::vector<vt_point>;
     using container_type::container_type;
     double area = 0.0; // polygon ring area
+    vt_ranking ranking; // only set for large rings
+    vt_segment_index_ptr segments; // only set for huge rings
 };
 
 using vt_multi_line_string = std::vector<vt_line_string>;
@@ -122,11 +171,48 @@ struct vt_geometry_type<geometry::geometry_collection<double>> {
     using type = vt_geometry_collection;
 };
 
+// largest line length and ring area in a geometry, used to tell whether it survives
+// simplification at a given tolerance
+struct vt_geometry_size {
+    double dist = 0.0;
+    double area = 0.0;
+    bool has_points = false;
+
+    void operator()(const vt_point&) {
+        has_points = true;
+    }
+
+    void operator()(const vt_multi_point& points) {
+        has_points = has_points || !points.empty();
+    }
+
+    void operator()(const vt_line_string& line) {
+        dist = std::max(dist, line.dist);
+    }
+
+    void operator()(const vt_linear_ring& ring) {
+        area = std::max(area, ring.area);
+    }
+
+    void operator()(const vt_geometry& geometry) {
+        vt_geometry::visit(geometry, [&](const auto& g) { (*this)(g); });
+    }
+
+    // Handles polygon, multi_line_string, multi_polygon, geometry_collection.
+    template <class T>
+    void operator()(const T& vector) {
+        for (const auto& e : vector) {
+            (*this)(e);
+        }
+    }
+};
+
 struct vt_feature {
     vt_geometry geometry;
     property_map properties;
     mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
     uint32_t num_points = 0;
+    vt_geometry_size size;
 
     vt_feature(const vt_geometry& geom, const property_map& props)
         : geometry(geom), properties(props) {
@@ -138,6 +224,23 @@ struct vt_feature {
             bbox.max.y = std::max(p.y, bbox.max.y);
             ++num_points;
         });
+
+        size(geom);
+    }
+
+    // for geometry whose bbox and number of points are known already, e.g. from clipping
+    vt_feature(vt_geometry&& geom,
+               const property_map& props,
+               const mapbox::geometry::box<double>& bbox_,
+               const uint32_t num_points_)
+        : geometry(std::move(geom)), properties(props), bbox(bbox_), num_points(num_points_) {
+        size(geometry);
+    }
+
+    // whether any part of the feature is kept when rendering a tile with the given tolerance;
+    // matches the line length and ring area checks in InternalTile
+    bool isVisible(const double tolerance) const {
+        return size.has_points || size.dist > tolerance || size.area > tolerance * tolerance;
     }
 };
 
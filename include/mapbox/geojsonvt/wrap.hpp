@@ -1,42 +1,200 @@
 #pragma once
 
 #include <mapbox/geojsonvt/clip.hpp>
+#include <mapbox/geojsonvt/thread_pool.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
 namespace mapbox {
 namespace geojsonvt {
 namespace detail {
 
-inline void shiftCoords(vt_features& features, double offset) {
-    for (auto& feature : features) {
-        mapbox::geometry::for_each_point(feature.geometry,
-                                         [offset](vt_point& point) { point.x += offset; });
-        feature.bbox.min.x += offset;
-        feature.bbox.max.x += offset;
+// moves the points of a geometry along x, along with the boxes of their segment indexes
+struct shifter {
+    const double offset;
+
+    void operator()(vt_point& point) const {
+        point.x += offset;
+    }
+
+    void operator()(vt_multi_point& points) const {
+        for (auto& point : points) {
+            point.x += offset;
+        }
+    }
+
+    void operator()(vt_line_string& line) const {
+        shiftPoints(line);
+    }
+
+    void operator()(vt_multi_line_string& lines) const {
+        for (auto& line : lines) {
+            shiftPoints(line);
+        }
+    }
+
+    void operator()(vt_polygon& polygon) const {
+        for (auto& ring : polygon) {
+            shiftPoints(ring);
+        }
+    }
+
+    void operator()(vt_multi_polygon& polygons) const {
+        for (auto& polygon : polygons) {
+            (*this)(polygon);
+        }
+    }
+
+    void operator()(vt_geometry_collection& geometries) const {
+        for (auto& geometry : geometries) {
+            vt_geometry::visit(geometry, *this);
+        }
     }
+
+private:
+    template <class T>
+    void shiftPoints(T& points) const {
+        for (auto& point : points) {
+            point.x += offset;
+        }
+        // the index may be shared with the unshifted original
+        if (points.segments) {
+            auto segments = std::make_shared<vt_segment_index>(*points.segments);
+            for (auto& box : segments->boxes) {
+                box.min.x += offset;
+                box.max.x += offset;
+            }
+            points.segments = std::move(segments);
+        }
+    }
+};
+
+inline void shiftCoords(vt_feature& feature, const double offset) {
+    vt_geometry::visit(feature.geometry, shifter{ offset });
+    feature.bbox.min.x += offset;
+    feature.bbox.max.x += offset;
 }
 
-inline vt_features wrap(const vt_features& features, double buffer) {
-    // left world copy
-    auto left = clip<0>(features, -1 - buffer, buffer, -1, 2);
-    // right world copy
-    auto right = clip<0>(features, 1 - buffer, 2 + buffer, -1, 2);
+// the part of the feature between k1 and k2, moved by offset
+inline vt_feature
+wrapPart(const vt_feature& feature, const double k1, const double k2, const double offset) {
+    vt_feature part = feature.bbox.min.x >= k1 && feature.bbox.max.x <= k2
+                          ? feature
+                          : clipFeature<0>(feature, k1, k2);
+    shiftCoords(part, offset);
+    return part;
+}
 
-    if (left.empty() && right.empty())
-        return features;
+// the parts of a range of features that wrap produces
+struct wrap_parts {
+    vt_features left;
+    vt_features center;
+    vt_features right;
 
-    // center world copy
-    auto merged = clip<0>(features, -buffer, 1 + buffer, -1, 2);
+    // positions in center of features beyond all three world copies, only kept if nothing
+    // gets wrapped
+    std::vector<size_t> outside;
+};
 
-    if (!left.empty()) {
-        // merge left into center
-        shiftCoords(left, 1.0);
-        merged.insert(merged.begin(), left.begin(), left.end());
+inline void wrapRange(vt_features& features,
+                      const size_t begin,
+                      const size_t end,
+                      const double buffer,
+                      wrap_parts& parts) {
+    parts.center.reserve(end - begin);
+
+    for (size_t i = begin; i < end; ++i) {
+        auto& feature = features[i];
+        const double min = feature.bbox.min.x;
+        const double max = feature.bbox.max.x;
+
+        const bool inLeft = !(min > buffer || max < -1 - buffer);
+        const bool inRight = !(min > 2 + buffer || max < 1 - buffer);
+
+        if (!inLeft && !inRight) {
+            if (max < -buffer || min > 1 + buffer)
+                parts.outside.push_back(parts.center.size());
+            parts.center.push_back(std::move(feature));
+            continue;
+        }
+
+        if (inLeft)
+            parts.left.push_back(wrapPart(feature, -1 - buffer, buffer, 1.0));
+        if (inRight)
+            parts.right.push_back(wrapPart(feature, 1 - buffer, 2 + buffer, -1.0));
+
+        if (min > 1 + buffer || max < -buffer)
+            continue;
+        else if (min >= -buffer && max <= 1 + buffer)
+            parts.center.push_back(std::move(feature));
+        else
+            parts.center.push_back(clipFeature<0>(feature, -buffer, 1 + buffer));
+    }
+}
+
+// inputs with at least this many features are wrapped on several threads, in chunks of this
+// many features
+constexpr size_t wrap_parallel_threshold = 4096;
+constexpr size_t wrap_chunk_size = 1024;
+
+/* Copies the parts of features that reach over the antimeridian to the other side, within
+ * buffer. Done in a single pass: features well inside the world are moved along untouched,
+ * and only the ones near or beyond the edges are clipped into a left, center and right part,
+ * with the left and right parts shifted by one world. If no feature needs to be copied, the
+ * features are returned as they are. Large inputs are split into chunks that are wrapped in
+ * parallel and put back together in order, so the result doesn't depend on the threads.
+ */
+inline vt_features wrap(vt_features features, const double buffer, ThreadPool* pool = nullptr) {
+    std::vector<wrap_parts> chunks;
+    if (features.size() < wrap_parallel_threshold || !pool || pool->size() < 2) {
+        chunks.resize(1);
+        wrapRange(features, 0, features.size(), buffer, chunks[0]);
+    } else {
+        chunks.resize((features.size() + wrap_chunk_size - 1) / wrap_chunk_size);
+        parallelChunks(features.size(), wrap_chunk_size, pool,
+                       [&](const size_t chunk, const size_t begin, const size_t end) {
+                           wrapRange(features, begin, end, buffer, chunks[chunk]);
+                       });
+    }
+
+    size_t wrapped = 0;
+    size_t outside = 0;
+    for (const auto& chunk : chunks) {
+        wrapped += chunk.left.size() + chunk.right.size();
+        outside += chunk.outside.size();
+    }
+
+    // features outside are only dropped if anything gets wrapped
+    if (wrapped == 0) {
+        if (chunks.size() == 1)
+            return std::move(chunks[0].center);
+        outside = 0;
+        for (auto& chunk : chunks) {
+            chunk.outside.clear();
+        }
+    }
+
+    vt_features merged;
+    merged.reserve(features.size() + wrapped - outside);
+
+    for (auto& chunk : chunks) {
+        std::move(chunk.left.begin(), chunk.left.end(), std::back_inserter(merged));
+    }
+    for (auto& chunk : chunks) {
+        auto next = chunk.outside.begin();
+        for (size_t i = 0; i < chunk.center.size(); ++i) {
+            if (next != chunk.outside.end() && *next == i)
+                ++next;
+            else
+                merged.push_back(std::move(chunk.center[i]));
+        }
     }
-    if (!right.empty()) {
-        // merge right into center
-        shiftCoords(right, -1.0);
-        merged.insert(merged.end(), right.begin(), right.end());
+    for (auto& chunk : chunks) {
+        std::move(chunk.right.begin(), chunk.right.end(), std::back_inserter(merged));
     }
     return merged;
 }
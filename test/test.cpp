@@ -6,10 +6,14 @@
 #include <mapbox/geojsonvt/convert.hpp>
 #include <mapbox/geojsonvt/simplify.hpp>
 #include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/wrap.hpp>
 #include <mapbox/geometry.hpp>
 
+#include <chrono>
 #include <cmath>
+#include <future>
 #include <iostream>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -80,6 +84,139 @@ TEST(Simplify, Points) {
     ASSERT_EQ(result, simplified);
 }
 
+TEST(Simplify, Parallel) {
+    std::vector<detail::vt_point> points;
+    const size_t len = detail::simplify_parallel_threshold + 1;
+    points.reserve(len);
+    for (size_t i = 0; i < len; ++i) {
+        const double t = double(i) / len;
+        points.emplace_back(t, 0.5 + 0.25 * std::sin(t * 400) * std::sin(t * 7));
+    }
+
+    auto serial = points;
+    detail::simplify(serial, 0.0001, 1);
+    detail::simplify(points, 0.0001, 4);
+
+    ASSERT_EQ(serial.size(), points.size());
+    for (size_t i = 0; i < len; ++i) {
+        ASSERT_EQ(serial[i].z, points[i].z);
+    }
+}
+
+TEST(Simplify, Visvalingam) {
+    const std::vector<detail::vt_point> line = {
+        { 0, 0 }, { 0.01, 0.01 }, { 0.02, 0 }, { 0.03, 0.001 }, { 0.05, 0 }
+    };
+
+    // removes the point at 0.03 first, then the peak, which leaves the point at 0.02 in a
+    // straight line with smaller area than the peak
+    auto points = line;
+    detail::simplify(points, 0, Simplification::VisvalingamWhyatt);
+    const std::vector<double> importance = { 1, 1e-4, 1e-4, 1.5e-5, 1 };
+    for (size_t i = 0; i < points.size(); ++i) {
+        EXPECT_DOUBLE_EQ(points[i].z, importance[i]);
+    }
+
+    points = line;
+    detail::simplify(points, std::sqrt(2e-5), Simplification::VisvalingamWhyatt);
+    EXPECT_EQ(points[3].z, 0);
+
+    // same features as with Douglas-Peucker, simplified differently
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    GeoJSONVT dp{ geojson, options };
+    options.simplification = Simplification::VisvalingamWhyatt;
+    GeoJSONVT vw{ geojson, options };
+    const auto& expected = dp.getTile(7, 37, 48).features;
+    const auto& features = vw.getTile(7, 37, 48).features;
+    ASSERT_EQ(features.size(), expected.size());
+    for (size_t i = 0; i < features.size(); ++i) {
+        EXPECT_EQ(features[i].properties, expected[i].properties);
+    }
+}
+
+TEST(Simplify, Ranking) {
+    mapbox::geometry::line_string<double> line;
+    for (size_t i = 0; i < detail::rank_threshold * 4; ++i) {
+        const double t = double(i) / (detail::rank_threshold * 4);
+        line.emplace_back(-170 + t * 340, 60 * std::sin(t * 40) * std::sin(t * 3));
+    }
+    const auto ranked = detail::convert({ { line } }, 3.0 / 4096 / 1024);
+    const auto& points = ranked[0].geometry.get<detail::vt_line_string>();
+    ASSERT_TRUE(points.ranking);
+
+    const auto& ranking = *points.ranking;
+    ASSERT_EQ(ranking.size(),
+              static_cast<size_t>(std::count_if(points.begin(), points.end(),
+                                                [](const auto& p) { return p.z > 0; })));
+    for (size_t i = 1; i < ranking.size(); ++i) {
+        ASSERT_GE(points[ranking[i - 1]].z, points[ranking[i]].z);
+    }
+
+    // tiles look the same whether or not their points are looked up in the ranking
+    auto unranked = ranked;
+    unranked[0].geometry.get<detail::vt_line_string>().ranking = nullptr;
+    for (const double tolerance : { 3.0 / 4096, 0.3 / 4096, 0.0 }) {
+        const detail::InternalTile a(ranked, 0, 0, 0, 4096, 64, tolerance);
+        const detail::InternalTile b(unranked, 0, 0, 0, 4096, 64, tolerance);
+        ASSERT_EQ(a.tile->features, b.tile->features);
+    }
+}
+
+TEST(Convert, Parallel) {
+    // lines of different lengths all over the world and beyond the antimeridian
+    mapbox::geometry::feature_collection<double> features;
+    for (size_t i = 0; i < detail::convert_parallel_threshold * 2; ++i) {
+        mapbox::geometry::line_string<double> line;
+        const double x = -270.0 + (i * 37) % 540;
+        const double y = -80.0 + (i * 13) % 160;
+        for (size_t j = 0; j < 2 + (i % 7) * (i % 11); ++j) {
+            line.emplace_back(x + j * 0.7, y + std::sin(j) * 2);
+        }
+        features.push_back({ line, { { "id", uint64_t(i) } } });
+    }
+
+    detail::ThreadPool pool(4);
+    const auto serial = detail::wrap(detail::convert(features, 1e-6), 0.01);
+    const auto parallel = detail::wrap(
+        detail::convert(features, 1e-6, Simplification::DouglasPeucker, &pool), 0.01, &pool);
+
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (size_t i = 0; i < serial.size(); ++i) {
+        ASSERT_EQ(serial[i].properties, parallel[i].properties);
+        ASSERT_EQ(serial[i].geometry, parallel[i].geometry);
+        ASSERT_EQ(serial[i].num_points, parallel[i].num_points);
+    }
+}
+
+TEST(Convert, HilbertOrder) {
+    // the curve runs through the quadrants top left, bottom left, bottom right, top right
+    mapbox::geometry::feature_collection<double> features;
+    for (const auto& p : { std::make_pair(90, 45), std::make_pair(90, -45),
+                           std::make_pair(-90, -45), std::make_pair(-90, 45) }) {
+        features.push_back({ mapbox::geometry::point<double>(p.first, p.second),
+                             { { "x", int64_t(p.first) }, { "y", int64_t(p.second) } } });
+    }
+
+    auto converted = detail::convert(features, 0);
+    detail::sortByHilbert(converted);
+    ASSERT_EQ(converted.size(), 4u);
+    EXPECT_EQ(converted[0].properties, features[3].properties);
+    EXPECT_EQ(converted[1].properties, features[2].properties);
+    EXPECT_EQ(converted[2].properties, features[1].properties);
+    EXPECT_EQ(converted[3].properties, features[0].properties);
+
+    // tiles keep the same features, in a different order
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    GeoJSONVT index{ geojson, options };
+    options.hilbertOrder = true;
+    GeoJSONVT sorted{ geojson, options };
+    EXPECT_EQ(index.getTile(7, 37, 48).features.size(),
+              sorted.getTile(7, 37, 48).features.size());
+    EXPECT_EQ(index.getTile(4, 3, 5).num_points, sorted.getTile(4, 3, 5).num_points);
+}
+
 TEST(Clip, Polylines) {
     const detail::vt_line_string points1{ { 0, 0 },   { 50, 0 },  { 50, 10 }, { 20, 10 },
                                           { 20, 20 }, { 30, 20 }, { 30, 30 }, { 50, 30 },
@@ -175,6 +312,84 @@ TEST(Clip, Points) {
     ASSERT_EQ(expected2, clipped2);
 }
 
+TEST(Clip, SegmentIndex) {
+    // a jagged ring and line with long runs of points on either side of the slabs
+    mapbox::geometry::linear_ring<double> ring;
+    mapbox::geometry::line_string<double> line;
+    for (size_t i = 0; i < 20000; ++i) {
+        const double t = 2 * M_PI * i / 20000;
+        const double r = 40 + 5 * std::sin(t * 150);
+        ring.emplace_back(r * std::cos(t), r * std::sin(t));
+        line.emplace_back(-170 + i * 0.017, 30 * std::sin(t * 3) + std::sin(t * 500));
+    }
+    ring.push_back(ring.front());
+    const mapbox::geometry::feature_collection<double> features = {
+        { mapbox::geometry::polygon<double>{ ring }, {} }, { line, {} }
+    };
+
+    const auto plain = detail::convert(features, 1e-7);
+    const auto indexed =
+        detail::convert(features, 1e-7, Simplification::DouglasPeucker, nullptr, 1000);
+    ASSERT_TRUE(indexed[0].geometry.get<detail::vt_polygon>()[0].segments);
+    ASSERT_TRUE(indexed[1].geometry.get<detail::vt_line_string>().segments);
+
+    for (const double k : { 0.3, 0.45, 0.5, 0.61 }) {
+        const auto expected =
+            detail::clip<1>(detail::clip<0>(plain, k, k + 0.05, 0, 1), k, k + 0.1, 0, 1);
+        const auto clipped =
+            detail::clip<1>(detail::clip<0>(indexed, k, k + 0.05, 0, 1), k, k + 0.1, 0, 1);
+
+        ASSERT_EQ(expected.size(), clipped.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQ(expected[i].geometry, clipped[i].geometry);
+            ASSERT_EQ(expected[i].bbox, clipped[i].bbox);
+            ASSERT_EQ(expected[i].num_points, clipped[i].num_points);
+        }
+    }
+}
+
+TEST(Wrap, SegmentIndex) {
+    // a jagged ring next to the antimeridian, so that a copy of it is shifted by one world
+    mapbox::geometry::linear_ring<double> ring;
+    for (size_t i = 0; i < 5000; ++i) {
+        const double t = 2 * M_PI * i / 5000;
+        const double r = 1.5 + 0.2 * std::sin(t * 100);
+        ring.emplace_back(-178 + r * std::cos(t), 10 + r * std::sin(t));
+    }
+    ring.push_back(ring.front());
+    const mapbox::geometry::feature_collection<double> features = {
+        { mapbox::geometry::polygon<double>{ ring }, {} }
+    };
+
+    const auto plain = detail::wrap(detail::convert(features, 1e-7), 0.02);
+    const auto indexed = detail::wrap(
+        detail::convert(features, 1e-7, Simplification::DouglasPeucker, nullptr, 1000), 0.02);
+    ASSERT_EQ(2u, indexed.size());
+
+    for (const double k : { 0.99, 1.0, 1.005 }) {
+        const auto expected = detail::clip<0>(plain, k, k + 0.01, 0, 1);
+        const auto clipped = detail::clip<0>(indexed, k, k + 0.01, 0, 1);
+
+        ASSERT_EQ(expected.size(), clipped.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQ(expected[i].geometry, clipped[i].geometry);
+            ASSERT_EQ(expected[i].num_points, clipped[i].num_points);
+        }
+    }
+
+    Options options;
+    GeoJSONVT index{ features, options };
+    options.segmentIndexMinPoints = 0;
+    GeoJSONVT unindexed{ features, options };
+    for (const auto& id : { std::make_tuple(1, 1, 0), std::make_tuple(2, 3, 1),
+                            std::make_tuple(3, 7, 3) }) {
+        const auto& tile = index.getTile(std::get<0>(id), std::get<1>(id), std::get<2>(id));
+        ASSERT_FALSE(tile.features.empty());
+        ASSERT_TRUE(tile.features ==
+                    unindexed.getTile(std::get<0>(id), std::get<1>(id), std::get<2>(id)).features);
+    }
+}
+
 TEST(GetTile, USStates) {
     const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
     GeoJSONVT index{ geojson.get<mapbox::geojson::feature_collection>() };
@@ -280,6 +495,531 @@ TEST(GetTile, Projection) {
     }
 }
 
+TEST(GetTile, SmallFeatures) {
+    // too small to show up before z3, and crossing tile boundaries from z9 on
+    const mapbox::geometry::polygon<double> square{
+        { { -0.02, -0.02 }, { 0.02, -0.02 }, { 0.02, 0.02 }, { -0.02, 0.02 }, { -0.02, -0.02 } }
+    };
+    GeoJSONVT index{ mapbox::geometry::geometry<double>{ square } };
+
+    ASSERT_EQ(0u, index.getTile(0, 0, 0).features.size());
+    ASSERT_EQ(1u, index.getTile(3, 4, 4).features.size());
+
+    const auto& tile = index.getTile(9, 256, 256);
+    ASSERT_EQ(1u, tile.features.size());
+    const auto& rings = tile.features.front().geometry.get<mapbox::geometry::polygon<int16_t>>();
+    for (const auto& p : rings.front()) {
+        ASSERT_TRUE(p.x >= -64 && p.x <= 4160 && p.y >= -64 && p.y <= 4160);
+    }
+}
+
+TEST(GetTile, Budget) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    GeoJSONVT full{ geojson };
+    const auto& unlimited = full.getTile(2, 0, 1);
+
+    Options options;
+    options.tileMaxPoints = 200;
+    options.tileMaxFeatures = 20;
+    GeoJSONVT index{ geojson, options };
+    const auto& tile = index.getTile(2, 0, 1);
+
+    ASSERT_GT(unlimited.num_simplified, 200u);
+    ASSERT_GT(unlimited.features.size(), 20u);
+    ASSERT_LE(tile.num_simplified, 200u);
+    ASSERT_LE(tile.features.size(), 20u);
+    ASSERT_GT(tile.features.size(), 0u);
+    ASSERT_EQ(unlimited.num_points, tile.num_points);
+}
+
+TEST(GetTile, Clusters) {
+    mapbox::geometry::feature_collection<double> features;
+    for (uint64_t i = 0; i < 100; ++i) {
+        features.push_back({ mapbox::geometry::point<double>(10 + i * 0.001, 10),
+                             mapbox::geometry::property_map{ { "count", i } } });
+    }
+    features.push_back({ mapbox::geometry::point<double>(-100, -40),
+                         mapbox::geometry::property_map{ { "count", uint64_t(1000) } } });
+
+    Options options;
+    options.maxZoom = 14;
+    options.clusterRadius = 64;
+    GeoJSONVT index{ features, options };
+
+    const auto& tile = index.getTile(0, 0, 0);
+    ASSERT_EQ(2u, tile.features.size());
+    ASSERT_EQ(2u, tile.num_simplified);
+    ASSERT_EQ(101u, tile.num_points);
+
+    const auto& cluster = tile.features[0].properties;
+    ASSERT_EQ(true, cluster.at("cluster").get<bool>());
+    ASSERT_EQ(100u, cluster.at("point_count").get<uint64_t>());
+    ASSERT_EQ(4950u, cluster.at("count").get<uint64_t>());
+    ASSERT_EQ(1000u, tile.features[1].properties.at("count").get<uint64_t>());
+
+    // full detail at maxZoom
+    const auto& detail = index.getTile(14, 8647, 7734);
+    ASSERT_EQ(20u, detail.features.size());
+    for (const auto& feature : detail.features) {
+        ASSERT_EQ(0u, feature.properties.count("cluster"));
+    }
+}
+
+TEST(GetTile, Async) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    Options options;
+    options.threads = 2;
+    GeoJSONVT index{ geojson, options };
+
+    auto tile = index.getTileAsync(7, 37, 48);
+    auto square = index.getTileAsync(9, 148, 192);
+    auto invalid = index.getTileAsync(19, 0, 0);
+
+    ASSERT_EQ(&index.getTile(7, 37, 48), tile.get().get());
+    ASSERT_EQ(&index.getTile(9, 148, 192), square.get().get());
+    ASSERT_THROW(invalid.get(), std::runtime_error);
+
+    std::promise<const Tile*> done;
+    index.getTileAsync(11, 800, 400, [&](std::exception_ptr error, const Tile& result) {
+        ASSERT_FALSE(error);
+        done.set_value(&result);
+    });
+    ASSERT_EQ(&empty_tile, done.get_future().get());
+}
+
+TEST(GetTile, Cancellation) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT index{ geojson };
+
+    CancellationToken canceled;
+    canceled.cancel();
+    ASSERT_THROW(index.getTile(7, 37, 48, canceled), CanceledError);
+
+    const CancellationToken expired{ CancellationToken::clock::now() };
+    ASSERT_THROW(index.getTile(9, 148, 192, expired), CanceledError);
+    ASSERT_THROW(index.getTileAsync(9, 148, 192, expired).get(), CanceledError);
+
+    // canceled requests leave the index usable
+    const auto expected = parseJSONTile(loadFile("test/fixtures/us-states-z7-37-48.json"));
+    ASSERT_EQ(expected == index.getTile(7, 37, 48).features, true);
+
+    const CancellationToken later{ CancellationToken::clock::now() + std::chrono::hours(1) };
+    const auto square = parseJSONTile(loadFile("test/fixtures/us-states-square.json"));
+    ASSERT_EQ(square == index.getTile(9, 148, 192, later).features, true);
+}
+
+TEST(GetTile, DedupTiles) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    Options options;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+    options.dedupTiles = true;
+    GeoJSONVT index{ geojson, options };
+
+    ASSERT_LT(index.uniqueTileBytes, index.tileBytes);
+
+    std::map<const Tile*, uint32_t> uses;
+    for (const auto& pair : index.getInternalTiles()) {
+        uses[pair.second.tile.get()]++;
+    }
+    ASSERT_LT(uses.size(), index.total);
+
+    // only solid squares and empty tiles repeat in this data
+    for (const auto& pair : index.getInternalTiles()) {
+        if (uses[pair.second.tile.get()] > 1) {
+            ASSERT_TRUE(pair.second.is_solid || pair.second.tile->features.empty());
+        }
+    }
+
+    // tile memory is only counted along with deduplication
+    options.dedupTiles = false;
+    GeoJSONVT plain{ geojson, options };
+    ASSERT_EQ(0u, plain.tileBytes);
+    ASSERT_EQ(0u, plain.uniqueTileBytes);
+}
+
+TEST(GetTile, Overzoom) {
+    const mapbox::geometry::feature_collection<double> features{
+        { mapbox::geometry::line_string<double>{ { -10, -10 }, { 10.3, 10.7 } } }
+    };
+
+    Options options;
+    options.maxZoom = 8;
+    options.overzoom = 4;
+    GeoJSONVT index{ features, options };
+
+    options.maxZoom = 12;
+    options.overzoom = 0;
+    GeoJSONVT reference{ features, options };
+
+    ASSERT_THROW(index.getTile(13, 2104, 1990), std::runtime_error);
+    ASSERT_EQ(&empty_tile, &index.getTile(12, 0, 0));
+
+    size_t compared = 0;
+    for (uint32_t y = 1980; y < 2000; ++y) {
+        const auto& expected = reference.getTile(12, 2104, y);
+        const auto& tile = index.getTile(12, 2104, y);
+        ASSERT_EQ(&tile, &index.getTile(12, 2104, y));
+        ASSERT_EQ(expected.features.size(), tile.features.size());
+        if (expected.features.empty())
+            continue;
+
+        const auto& a = expected.features[0].geometry.get<mapbox::geometry::line_string<int16_t>>();
+        const auto& b = tile.features[0].geometry.get<mapbox::geometry::line_string<int16_t>>();
+        ASSERT_EQ(a.size(), b.size());
+        // within one unit of the quantized z8 tile
+        for (size_t i = 0; i < a.size(); ++i) {
+            ASSERT_NEAR(a[i].x, b[i].x, 16);
+            ASSERT_NEAR(a[i].y, b[i].y, 16);
+        }
+        compared++;
+    }
+    ASSERT_GT(compared, 0u);
+    ASSERT_EQ(20u, index.stats[12]);
+
+    // only the newest overzoomed tiles are kept
+    options.maxZoom = 8;
+    options.overzoom = 4;
+    options.overzoomCacheSize = 2;
+    GeoJSONVT bounded{ features, options };
+    std::vector<std::shared_ptr<const Tile>> tiles;
+    for (uint32_t y = 1980; y < 2000; ++y) {
+        tiles.push_back(bounded.getSharedTile(12, 2104, y));
+    }
+    ASSERT_EQ(2u, bounded.stats[12]);
+    ASSERT_EQ(tiles.back(), bounded.getSharedTile(12, 2104, 1999));
+    ASSERT_NE(tiles.front(), bounded.getSharedTile(12, 2104, 1980));
+}
+
+TEST(GetTile, TransientDrillDown) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT reference{ geojson };
+
+    Options options;
+    options.transientDrillDown = true;
+    GeoJSONVT index{ geojson, options };
+    const auto indexed = index.total;
+
+    // only the requested tile is stored
+    const auto& tile = index.getTile(14, 37 * 128 + 40, 48 * 128 + 70);
+    ASSERT_FALSE(tile.features.empty());
+    ASSERT_EQ(tile == reference.getTile(14, 37 * 128 + 40, 48 * 128 + 70), true);
+    ASSERT_EQ(indexed + 1, index.total);
+
+    // neighbours start from the z12 checkpoint
+    for (uint32_t i = 0; i < 4; ++i) {
+        const uint32_t x = 37 * 128 + 40 + i % 2;
+        const uint32_t y = 48 * 128 + 71 + i / 2;
+        ASSERT_EQ(index.getTile(14, x, y) == reference.getTile(14, x, y), true);
+    }
+    ASSERT_EQ(indexed + 5, index.total);
+    ASSERT_LT(index.total, reference.total);
+
+    ASSERT_EQ(index.getTile(9, 148, 192) == reference.getTile(9, 148, 192), true);
+    ASSERT_EQ(&empty_tile, &index.getTile(11, 800, 400));
+}
+
+TEST(GetTile, EmptyRegions) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    CancellationToken canceled;
+    canceled.cancel();
+
+    Options options;
+    for (const bool transient : { false, true }) {
+        options.transientDrillDown = transient;
+        GeoJSONVT index{ geojson, options };
+
+        ASSERT_THROW(index.getTile(14, 2275, 6760, canceled), CanceledError);
+        ASSERT_EQ(&empty_tile, &index.getTile(14, 2275, 6760));
+        const auto total = index.total;
+
+        // known to be empty, so no clipping happens and the token is never checked
+        ASSERT_EQ(&empty_tile, &index.getTile(14, 2275, 6760, canceled));
+        ASSERT_EQ(&empty_tile, &index.getTile(14, 2276, 6762, canceled));
+        ASSERT_EQ(&empty_tile, &index.getTile(10, 142, 422, canceled));
+        ASSERT_EQ(total, index.total);
+    }
+}
+
+TEST(GetTile, Subtrees) {
+    ASSERT_EQ(toQuadkeyID(1, 1, 0), toQuadkeyIDEnd(1, 0, 0) + 1);
+    ASSERT_LT(toQuadkeyID(0, 0, 0), toQuadkeyID(1, 0, 0));
+    ASSERT_LT(toQuadkeyID(14, 16383, 16383), toQuadkeyIDEnd(3, 7, 7));
+    ASSERT_LT(toQuadkeyIDEnd(7, 37, 48), toQuadkeyID(7, 38, 48));
+    ASSERT_LT(toQuadkeyID(7, 37, 48), toQuadkeyID(14, 37 * 128 + 127, 48 * 128 + 127));
+    ASSERT_LT(toQuadkeyID(14, 37 * 128 + 127, 48 * 128 + 127), toQuadkeyIDEnd(7, 37, 48));
+
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT reference{ geojson };
+
+    Options options;
+    options.orderedTiles = true;
+    GeoJSONVT split{ geojson, options };
+    split.getTile(4, 3, 5);
+    ASSERT_EQ(17u, split.countTiles(0, 0, 0));
+    ASSERT_EQ(9u, split.countTiles(2, 0, 1));
+    ASSERT_THROW(split.evictTiles(4, 3, 5), std::runtime_error);
+    ASSERT_EQ(17u, split.countTiles(0, 0, 0));
+
+    // the tiles below a split tile of the index can't be rendered again
+    options.transientDrillDown = true;
+    options.indexMaxPoints = 1000;
+    GeoJSONVT deeper{ geojson, options };
+    ASSERT_THROW(deeper.evictTiles(0, 0, 0), std::runtime_error);
+
+    options.indexMaxPoints = Options().indexMaxPoints;
+    options.overzoom = 1;
+    GeoJSONVT index{ geojson, options };
+    const auto indexed = index.getInternalTiles().size();
+    ASSERT_EQ(indexed, index.countTiles(0, 0, 0));
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        index.getTile(14, 37 * 128 + 40 + i, 48 * 128 + 70);
+    }
+    index.getTile(10, 37 * 8 + 2, 48 * 8 + 4);
+    ASSERT_FALSE(index.getTile(8, 76, 96).features.empty());
+    ASSERT_EQ(indexed + 6, index.getInternalTiles().size());
+    ASSERT_EQ(5u, index.countTiles(7, 37, 48));
+
+    std::vector<std::tuple<uint8_t, uint32_t, uint32_t>> visited;
+    index.forEachTile(7, 37, 48, [&](const detail::InternalTile& tile) {
+        visited.emplace_back(tile.z, tile.x, tile.y);
+    });
+    ASSERT_EQ(5u, visited.size());
+    ASSERT_EQ(std::make_tuple(10, 37 * 8 + 2, 48 * 8 + 4), visited[0]);
+    ASSERT_EQ(std::make_tuple(14, 37 * 128 + 40, 48 * 128 + 70), visited[1]);
+
+    ASSERT_EQ(indexed + 6, index.total);
+    ASSERT_EQ(4u, index.stats[14]);
+
+    const auto held = index.getSharedTile(14, 37 * 128 + 40, 48 * 128 + 70);
+    const auto expected = held->features;
+    const auto overzoomed = index.getSharedTile(15, 37 * 256 + 80, 48 * 256 + 140);
+    ASSERT_FALSE(overzoomed->features.empty());
+
+    ASSERT_EQ(5u, index.evictTiles(7, 37, 48));
+    ASSERT_EQ(expected, held->features);
+
+    // rendered again rather than taken from the overzoomed cache
+    const auto again = index.getSharedTile(15, 37 * 256 + 80, 48 * 256 + 140);
+    ASSERT_NE(overzoomed, again);
+    ASSERT_EQ(*overzoomed == *again, true);
+    ASSERT_EQ(1u, index.evictTiles(7, 37, 48));
+    ASSERT_EQ(0u, index.countTiles(7, 37, 48));
+    ASSERT_EQ(indexed + 1, index.getInternalTiles().size());
+    ASSERT_EQ(indexed + 1, index.total);
+    ASSERT_EQ(0u, index.stats.count(14));
+    ASSERT_EQ(0u, index.stats.count(10));
+    uint32_t counted = 0;
+    for (const auto& zoom : index.stats) {
+        counted += zoom.second;
+    }
+    ASSERT_EQ(index.total, counted);
+
+    const auto& tile = index.getTile(14, 37 * 128 + 41, 48 * 128 + 70);
+    ASSERT_EQ(tile == reference.getTile(14, 37 * 128 + 41, 48 * 128 + 70), true);
+    ASSERT_EQ(1u, index.countTiles(7, 37, 48));
+}
+
+TEST(GetTile, RenderSubtree) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT reference{ geojson };
+    GeoJSONVT index{ geojson };
+    const auto indexed = index.getInternalTiles().size();
+
+    // from a tile in the index and from one below it
+    for (const auto& root : { std::make_tuple(3, 1, 3), std::make_tuple(7, 37, 48) }) {
+        const uint8_t z = std::get<0>(root);
+        const uint8_t maxZ = z + 3;
+        std::set<std::tuple<uint8_t, uint32_t, uint32_t>> rendered;
+        index.renderSubtree(z, std::get<1>(root), std::get<2>(root), maxZ,
+                            [&](uint8_t z0, uint32_t x0, uint32_t y0, const Tile& tile) {
+                                ASSERT_EQ(tile == reference.getTile(z0, x0, y0), true);
+                                rendered.emplace(z0, x0, y0);
+                            });
+
+        std::size_t expected = 0;
+        for (uint8_t z0 = z; z0 <= maxZ; ++z0) {
+            const uint32_t n = 1u << (z0 - z);
+            for (uint32_t i = 0; i < n * n; ++i) {
+                const uint32_t x0 = std::get<1>(root) * n + i % n;
+                const uint32_t y0 = std::get<2>(root) * n + i / n;
+                if (!reference.getTile(z0, x0, y0).features.empty()) {
+                    ASSERT_EQ(1u, rendered.count(std::make_tuple(z0, x0, y0)));
+                    expected++;
+                }
+            }
+        }
+        ASSERT_EQ(expected, rendered.size());
+    }
+    ASSERT_EQ(indexed, index.getInternalTiles().size());
+
+    // too small to show until a few zoom levels down
+    const mapbox::geometry::polygon<double> square = {
+        { { 10, 10 }, { 10.01, 10 }, { 10.01, 10.01 }, { 10, 10.01 }, { 10, 10 } }
+    };
+    Options options;
+    options.maxZoom = 12;
+    GeoJSONVT small{ mapbox::geometry::feature<double>{ square }, options };
+    ASSERT_TRUE(small.getTile(0, 0, 0).features.empty());
+    std::size_t found = 0;
+    small.renderSubtree(0, 0, 0, 12, [&](uint8_t z0, uint32_t x0, uint32_t y0, const Tile&) {
+        found += z0 == 12 && x0 == 2161 && y0 == 1933;
+    });
+    ASSERT_EQ(1u, found);
+}
+
+TEST(GetTile, ParallelClip) {
+    // small squares spread over western Europe, enough to be clipped on several threads down
+    // to about z6
+    mapbox::geometry::feature_collection<double> features;
+    for (size_t i = 0; i < detail::clip_parallel_threshold * 4; ++i) {
+        const double x = -10 + (i * 7919 % 10007) * 0.003;
+        const double y = 35 + (i * 104729 % 10009) * 0.0025;
+        mapbox::geometry::linear_ring<double> ring = {
+            { x, y }, { x + 0.2, y }, { x + 0.2, y + 0.2 }, { x, y + 0.2 }, { x, y }
+        };
+        features.push_back({ mapbox::geometry::polygon<double>{ ring }, {} });
+    }
+
+    Options options;
+    options.indexMaxZoom = 2;
+    GeoJSONVT serial{ features, options };
+    options.chunkThreads = 4;
+    GeoJSONVT parallel{ features, options };
+
+    ASSERT_EQ(serial.total, parallel.total);
+    for (const auto& tile : { std::make_tuple(3, 4, 2), std::make_tuple(6, 32, 22),
+                              std::make_tuple(8, 131, 90), std::make_tuple(10, 526, 360) }) {
+        const auto z = std::get<0>(tile);
+        const auto x = std::get<1>(tile);
+        const auto y = std::get<2>(tile);
+        ASSERT_FALSE(serial.getTile(z, x, y).features.empty());
+        ASSERT_EQ(serial.getTile(z, x, y).features, parallel.getTile(z, x, y).features);
+    }
+
+    // clipping from two getTileAsync tasks at once, sharing the chunk pool
+    options.indexMaxZoom = 0;
+    options.threads = 2;
+    options.chunkThreads = 2;
+    GeoJSONVT async{ features, options };
+    auto first = async.getTileAsync(3, 4, 2);
+    auto second = async.getTileAsync(6, 32, 22);
+    ASSERT_EQ(serial.getTile(3, 4, 2).features, first.get()->features);
+    ASSERT_EQ(serial.getTile(6, 32, 22).features, second.get()->features);
+}
+
+TEST(GetTile, FixedPoint) {
+    // points around a z14 tile and its buffer, rendered in fixed point
+    const uint8_t z = 14;
+    const uint32_t x = 8508;
+    const uint32_t y = 5489;
+    mapbox::geometry::multi_point<double> points;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        points.emplace_back(6.9375 + (i % 40) * 0.000625, 50.9315 + (i / 40) * 0.0006);
+    }
+
+    Options options;
+    options.fixedPointMinZoom = 12;
+    GeoJSONVT index{ mapbox::geometry::feature<double>{ points }, options };
+    const auto& tile = index.getTile(z, x, y);
+    ASSERT_EQ(tile.features.size(), 1u);
+    const auto& rendered = tile.features[0].geometry.get<mapbox::geometry::multi_point<int16_t>>();
+
+    // the same points in floating point
+    const auto projected = detail::convert({ { points } }, 0)[0].geometry;
+    std::vector<mapbox::geometry::point<int16_t>> expected;
+    for (const auto& p : projected.get<detail::vt_multi_point>()) {
+        const double px = std::round((p.x * (1 << z) - x) * 4096);
+        const double py = std::round((p.y * (1 << z) - y) * 4096);
+        if (px >= -64 && px <= 4096 + 64 && py >= -64 && py <= 4096 + 64)
+            expected.emplace_back(px, py);
+    }
+
+    ASSERT_GT(expected.size(), 100u);
+    ASSERT_EQ(rendered.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_LE(std::abs(rendered[i].x - expected[i].x), 1);
+        EXPECT_LE(std::abs(rendered[i].y - expected[i].y), 1);
+    }
+
+    // floating point by default
+    GeoJSONVT plain{ mapbox::geometry::feature<double>{ points } };
+    ASSERT_EQ(expected, plain.getTile(z, x, y)
+                            .features[0]
+                            .geometry.get<mapbox::geometry::multi_point<int16_t>>());
+}
+
+TEST(GetTile, MultiLayer) {
+    const auto states = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"))
+                            .get<mapbox::geojson::feature_collection>();
+
+    Layer detailed{ "detailed", states };
+    Layer coarse{ "coarse", states };
+    coarse.maxZoom = 10;
+    coarse.tolerance = 10;
+
+    Options options;
+    options.indexMaxZoom = 2;
+    MultiLayerGeoJSONVT index{ { detailed, coarse }, options };
+
+    GeoJSONVT detailedIndex{ states };
+    options.maxZoom = 10;
+    options.tolerance = 10;
+    GeoJSONVT coarseIndex{ states, options };
+
+    const auto& tiles = index.getTile(7, 37, 48);
+    ASSERT_EQ(2u, tiles.size());
+    ASSERT_EQ(*tiles.at("detailed") == detailedIndex.getTile(7, 37, 48), true);
+    ASSERT_EQ(*tiles.at("coarse") == coarseIndex.getTile(7, 37, 48), true);
+
+    const auto& low = index.getTile(3, 1, 3);
+    ASSERT_LT(low.at("coarse")->num_simplified, low.at("detailed")->num_simplified);
+
+    // past the coarse layer's maxZoom
+    const auto& deep = index.getTile(12, 37 * 32, 48 * 32 + 20);
+    ASSERT_EQ(*deep.at("detailed") == detailedIndex.getTile(12, 37 * 32, 48 * 32 + 20), true);
+    ASSERT_TRUE(deep.at("coarse")->features.empty());
+
+    ASSERT_EQ(&empty_tile, index.getTile(11, 800, 400).at("coarse").get());
+
+    // options that only GeoJSONVT supports
+    for (size_t i = 0; i < 4; ++i) {
+        Options unsupported;
+        unsupported.dedupTiles = i == 0;
+        unsupported.overzoom = i == 1 ? 2 : 0;
+        unsupported.transientDrillDown = i == 2;
+        unsupported.orderedTiles = i == 3;
+        ASSERT_THROW(MultiLayerGeoJSONVT({ coarse }, unsupported), std::runtime_error);
+    }
+}
+
+TEST(GetTile, MultiLayerSmallFeatures) {
+    // a building too small to show at low zooms, inside a polygon that covers whole tiles
+    const mapbox::geometry::polygon<double> land = { { { -50, -40 }, { 50, -40 }, { 50, 40 },
+                                                       { -50, 40 }, { -50, -40 } } };
+    const mapbox::geometry::polygon<double> building = {
+        { { 10, 10 }, { 10.001, 10 }, { 10.001, 10.001 }, { 10, 10.001 }, { 10, 10 } }
+    };
+    const mapbox::geometry::feature_collection<double> buildings = { { building, {} } };
+
+    Layer landLayer{ "land", { { land, {} } } };
+    Layer buildingLayer{ "buildings", buildings };
+    MultiLayerGeoJSONVT index{ { landLayer, buildingLayer } };
+    GeoJSONVT buildingIndex{ buildings };
+
+    for (const auto& id : { std::make_tuple(10, 540, 483), std::make_tuple(12, 2161, 1933),
+                            std::make_tuple(14, 8647, 7734) }) {
+        const auto& tile = buildingIndex.getTile(std::get<0>(id), std::get<1>(id), std::get<2>(id));
+        ASSERT_EQ(1u, tile.features.size());
+        const auto& tiles = index.getTile(std::get<0>(id), std::get<1>(id), std::get<2>(id));
+        ASSERT_EQ(*tiles.at("buildings") == tile, true);
+    }
+}
+
 std::map<std::string, mapbox::geometry::feature_collection<int16_t>>
 genTiles(const std::string& data, uint8_t maxZoom = 0, uint32_t maxPoints = 10000) {
     Options options;